@@ -3,6 +3,9 @@
 #include <iostream>
 #include <fstream>
 #include <cassert>
+#include <mutex>
+#include <vector>
+#include <algorithm>
 
 
 Benchmarker::BenchmarkStats& Benchmarker::BenchmarkStats::operator+=(const Benchmarker::BenchmarkStats& other)
@@ -14,7 +17,78 @@ Benchmarker::BenchmarkStats& Benchmarker::BenchmarkStats::operator+=(const Bench
 	return *this;
 }
 
-std::unordered_map<std::string, Benchmarker::BenchmarkStats> Benchmarker::benchmarkStats_s{};
+namespace
+{
+	void addStats(std::unordered_map<std::string, Benchmarker::BenchmarkStats>& allStats, const std::string& name, const Benchmarker::BenchmarkStats& stats)
+	{
+		auto [it, inserted] = allStats.try_emplace(name, stats);
+		if (!inserted)
+			it->second += stats;
+	}
+}
+
+struct Benchmarker::ThreadStats
+{
+	std::mutex mutex;
+	std::unordered_map<std::string, BenchmarkStats> stats;
+
+	ThreadStats();
+	~ThreadStats();
+};
+
+/// <summary>
+/// The stats of every thread that is still running, and the merged stats of the threads that have finished.
+/// </summary>
+struct Benchmarker::StatsRegistry
+{
+	std::mutex mutex;
+	std::vector<ThreadStats*> threads;
+	std::unordered_map<std::string, BenchmarkStats> finishedThreadStats;
+};
+
+Benchmarker::StatsRegistry& Benchmarker::statsRegistry()
+{
+	static StatsRegistry registry;
+	return registry;
+}
+
+Benchmarker::ThreadStats::ThreadStats()
+{
+	auto& registry = statsRegistry();
+	std::lock_guard lock(registry.mutex);
+	registry.threads.push_back(this);
+}
+
+Benchmarker::ThreadStats::~ThreadStats()
+{
+	auto& registry = statsRegistry();
+	std::lock_guard lock(registry.mutex);
+	for (auto& [name, threadStats] : stats)
+		addStats(registry.finishedThreadStats, name, threadStats);
+	registry.threads.erase(std::find(registry.threads.begin(), registry.threads.end(), this));
+}
+
+Benchmarker::ThreadStats& Benchmarker::threadStats()
+{
+	thread_local ThreadStats stats;
+	return stats;
+}
+
+std::unordered_map<std::string, Benchmarker::BenchmarkStats> Benchmarker::getAllStats()
+{
+	auto& registry = statsRegistry();
+	std::lock_guard lock(registry.mutex);
+
+	auto allStats = registry.finishedThreadStats;
+	for (auto* thread : registry.threads)
+	{
+		std::lock_guard threadLock(thread->mutex);
+		for (auto& [name, stats] : thread->stats)
+			addStats(allStats, name, stats);
+	}
+
+	return allStats;
+}
 
 Benchmarker::Benchmarker(const std::string& benchName)
 	: name_(benchName)
@@ -38,16 +112,9 @@ void Benchmarker::stop()
 	
 	auto duration = std::chrono::duration_cast<std::chrono::microseconds>(stopTime - startTime_);
 
-	if (benchmarkStats_s.find(name_) == benchmarkStats_s.end())
-		benchmarkStats_s[name_] = BenchmarkStats{ 1, duration, duration, duration };
-	else
-	{
-		auto& stats = benchmarkStats_s[name_];
-		stats.count++;
-		stats.totalDuration += duration;
-		stats.minDuration = std::min(stats.minDuration, duration);
-		stats.maxDuration = std::max(stats.maxDuration, duration);
-	}
+	auto& threadStats = Benchmarker::threadStats();
+	std::lock_guard lock(threadStats.mutex);
+	addStats(threadStats.stats, name_, BenchmarkStats{ duration });
 
 	stopped_ = true;
 }
@@ -67,7 +134,7 @@ Benchmarker::BenchmarkStats Benchmarker::stop_getStats()
 void Benchmarker::printStats()
 {
 	std::cout << "BENCHMARKER STATS:\n";
-	for (auto& [name, stats] : benchmarkStats_s)
+	for (auto& [name, stats] : getAllStats())
 	{
 		std::cout << "#####################################\n";
 		std::cout << "Benchmark name:     " << name << '\n';
@@ -88,7 +155,7 @@ void Benchmarker::writeStatsToFile(const std::string& fileName)
 		return;
 	}
 	
-	for (auto& [name, stats] : benchmarkStats_s)
+	for (auto& [name, stats] : getAllStats())
 	{
 		outFile 
 			<< name << ','
@@ -47,7 +47,8 @@ public:
 	void stop();
 	BenchmarkStats stop_getStats();
 
-	[[nodiscard]] inline static std::unordered_map<std::string, BenchmarkStats> getAllStats() { return benchmarkStats_s; };
+	// The stats of every thread, merged. Safe to call while other threads are benchmarking.
+	[[nodiscard]] static std::unordered_map<std::string, BenchmarkStats> getAllStats();
 
 	/// <summary>
 	/// Prints the stats to the console.
@@ -66,7 +67,11 @@ public:
 	static void runNormalTestWriteToFile(size_t sampleCount, std::string fileName, std::function<void()> functionToBenchmark);
 
 private:
-	static std::unordered_map<std::string, BenchmarkStats> benchmarkStats_s;
+	// Every thread records its stats on its own (behind a lock only it and readers take), so benchmarks on several threads don't contend with each other.
+	struct ThreadStats;
+	struct StatsRegistry;
+	[[nodiscard]] static ThreadStats& threadStats();
+	[[nodiscard]] static StatsRegistry& statsRegistry();
 
 	const std::string name_;
 	bool stopped_ = false;
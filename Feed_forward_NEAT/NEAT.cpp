@@ -1,11 +1,21 @@
 #include "NEAT.h"
+#include "flat_hash_map.h"
 
-#include <unordered_set>
 #include <utility>
 #include <random>
 #include <cassert>
+#include <algorithm>
+#include <numeric>
+#include <array>
+#include <limits>
+#include <mutex>
+#include <cstring>
 #include <benchmarker.h>
 
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
 namespace neat
 {
 
@@ -15,119 +25,277 @@ namespace neat
 	}
 
 	Genome::NodeGene::NodeGene(const NodeGene& other)
-		: type_(other.type_)
+		: type_(other.type_), incomming_(other.incomming_), outgoing_(other.outgoing_)
+	{
+	}
+
+	Genome::ConnectionGene::ConnectionGene()
+		: inNode_(0), outNode_(0), weight_(0), innovationAndExpressed_(0)
 	{
 	}
 
-	void Genome::NodeGene::evaluate(std::vector<NodeGene>& nodes)
+	Genome::ConnectionGene::ConnectionGene(uint64_t inNode, uint64_t outNode, float weight, bool expressed, uint64_t innovationNumber)
+		: inNode_(static_cast<uint32_t>(inNode)), outNode_(static_cast<uint32_t>(outNode)), weight_(weight), 
+		innovationAndExpressed_(static_cast<uint32_t>(innovationNumber) | (expressed ? expressedBit_c : 0))
 	{
-		value_ = 0;
-		for (auto conn : incomming_)
+		assert(inNode <= UINT32_MAX && outNode <= UINT32_MAX && "Node index does not fit in a connection gene!");
+		assert(innovationNumber < InnovationRegistry::maxInnovationCount_c && "Innovation number does not fit in a connection gene!");
+	}
+
+	namespace
+	{
+		/// <summary>
+		/// Every topology that is currently in use (with a hash that belongs to this table), by hash. Entries expire once no genome uses the topology anymore.
+		/// </summary>
+		struct TopologyTable
 		{
-			if (!conn->expressed_)
-				continue;
+			std::mutex mutex;
+			// Topologies with the same hash share a bucket.
+			FlatHashMap<uint64_t, std::vector<std::weak_ptr<const Genome::Topology>>> topologies;
+			// Expired entries are removed once the table grows past this many hashes.
+			size_t purgeSize = 64;
+		};
+
+		// Topologies are spread over several tables by hash, each with its own lock, so threads interning different topologies rarely wait for each other.
+		TopologyTable& topologyTable(uint64_t hash)
+		{
+			static std::array<TopologyTable, 16> tables;
+			return tables[(hash >> 32) % tables.size()];
+		}
 
-			value_ += conn->weight_ * nodes[conn->inNode_].getValue(nodes);
+		inline void combineHash(uint64_t& seed, uint64_t value)
+		{
+			seed ^= value + 0x9e3779b97f4a7c15ULL + (seed << 6) + (seed >> 2);
 		}
 
-		value_ = sigmoid(value_);
+		uint64_t randomSeed()
+		{
+			std::random_device rd;
+			return (static_cast<uint64_t>(rd()) << 32) ^ rd();
+		}
 
-		cached_ = true;
-	}
+		inline uint32_t countTrailingZeros(uint64_t value)
+		{
+#if defined(_MSC_VER)
+			unsigned long index;
+			_BitScanForward64(&index, value);
+			return index;
+#else
+			return __builtin_ctzll(value);
+#endif
+		}
 
+		inline uint32_t countSetBits(uint64_t value)
+		{
+#if defined(_MSC_VER)
+			return static_cast<uint32_t>(__popcnt64(value));
+#else
+			return __builtin_popcountll(value);
+#endif
+		}
 
-	Genome::ConnectionGene::ConnectionGene()
-		: inNode_(0), outNode_(0), weight_(0), expressed_(false), innovationNumber_(0)
-	{
+		/// <summary>
+		/// The number of consecutive items that together cost at least minCostPerTask, if every item costs the average. Used as the grain size of parallel loops.
+		/// </summary>
+		inline size_t grainSize(size_t itemCount, size_t totalCost, size_t minCostPerTask)
+		{
+			return totalCost == 0 ? itemCount : std::max<size_t>(1, minCostPerTask * itemCount / totalCost);
+		}
 	}
 
-	Genome::ConnectionGene::ConnectionGene(uint64_t inNode, uint64_t outNode, float weight, bool expressed, uint64_t innovationNumber)
-		: inNode_(inNode), outNode_(outNode), weight_(weight), expressed_(expressed), innovationNumber_(innovationNumber)
+	bool Genome::Topology::operator==(const Topology& other) const
 	{
-	}
+		if (hash_ != other.hash_ || nodeGenes_.size() != other.nodeGenes_.size() || connections_.size() != other.connections_.size())
+			return false;
 
-	uint64_t Genome::ConnectionGene::currentInnovationNumber_s = 0;
+		for (size_t i = 0; i < nodeGenes_.size(); i++)
+		{
+			if (nodeGenes_[i].type() != other.nodeGenes_[i].type() || nodeIds_[i] != other.nodeIds_[i])
+				return false;
+		}
 
+		// The endpoints are also compared, since they are indices into this topology's nodes (which garbage collection renumbers), rather than node ids.
+		for (size_t i = 0; i < connections_.size(); i++)
+		{
+			const auto& connection = connections_[i];
+			const auto& otherConnection = other.connections_[i];
+			if (connection.innovationNumber != otherConnection.innovationNumber || connection.inNode != otherConnection.inNode || connection.outNode != otherConnection.outNode)
+				return false;
+		}
+
+		return true;
+	}
 
+	InnovationRegistry Genome::innovationRegistry_s{};
 
-	std::unordered_map<std::pair<uint64_t, uint64_t>, uint64_t, hashPair> Genome::existingInnovations_s{};
+	InnovationRegistry& Genome::innovationRegistry()
+	{
+		return innovationRegistry_s;
+	}
 
 	Genome::Genome()
+		: topology_(internTopology(Topology{}))
 	{
 	}
 
 	Genome::Genome(const size_t inputCount, const size_t outputCount)
 		: inputCount_(inputCount), outputCount_(outputCount)
 	{
+		Topology topology;
 		for (size_t i = 0; i < inputCount; i++)
 		{
-			nodeGenes_.emplace_back(Genome::NodeGene::NodeType::INPUT);
+			topology.nodeGenes_.emplace_back(Genome::NodeGene::NodeType::INPUT);
 		}
-		nodeGenes_.emplace_back(Genome::NodeGene::NodeType::INPUT);
+		topology.nodeGenes_.emplace_back(Genome::NodeGene::NodeType::INPUT);
 
 		for (size_t i = 0; i < outputCount; i++)
 		{
-			nodeGenes_.emplace_back(Genome::NodeGene::NodeType::OUTPUT);
+			topology.nodeGenes_.emplace_back(Genome::NodeGene::NodeType::OUTPUT);
 		}
+
+		// Without any connections, any order is a valid topological order.
+		topology.topologicalOrder_.resize(topology.nodeGenes_.size());
+		std::iota(topology.topologicalOrder_.begin(), topology.topologicalOrder_.end(), 0);
+		topology.nodeOrder_ = topology.topologicalOrder_;
+		topology.nodeIds_ = topology.topologicalOrder_;
+		buildConnectionCandidates(topology);
+
+		topology_ = internTopology(std::move(topology));
+	}
+
+	Genome::Genome(uint64_t inputCount, uint64_t outputCount, uint64_t nodeCount, const Topology::Connection* connections, const float* weights, const uint64_t* expressed, size_t connectionCount, const uint64_t* topologicalOrder, const uint64_t* nodeIds)
+		: inputCount_(inputCount), outputCount_(outputCount)
+	{
+		Topology topology;
+
+		// Node types follow from their index: inputs, the bias node, outputs and then hidden nodes.
+		topology.nodeGenes_.reserve(nodeCount);
+		for (uint64_t i = 0; i < nodeCount; i++)
+		{
+			if (i <= inputCount)
+				topology.nodeGenes_.emplace_back(NodeGene::NodeType::INPUT);
+			else if (i <= inputCount + outputCount)
+				topology.nodeGenes_.emplace_back(NodeGene::NodeType::OUTPUT);
+			else
+				topology.nodeGenes_.emplace_back(NodeGene::NodeType::HIDDEN);
+		}
+
+		// The arrays are stored exactly like they are in memory.
+		topology.connections_.assign(connections, connections + connectionCount);
+		values_.weights.assign(weights, weights + connectionCount);
+		values_.expressed.assign(expressed, expressed + (connectionCount + 63) / 64);
+		values_.disabledSince.assign(connectionCount, 0);
+		shareValuesIfLarge();
+
+		topology.nodeIds_.assign(nodeIds, nodeIds + nodeCount);
+		topology.topologicalOrder_.assign(topologicalOrder, topologicalOrder + nodeCount);
+		topology.nodeOrder_.resize(nodeCount);
+		for (uint64_t i = 0; i < nodeCount; i++)
+			topology.nodeOrder_[topology.topologicalOrder_[i]] = i;
+
+		reconnectIncommingPointers(topology);
+		buildConnectionCandidates(topology);
+		topology_ = internTopology(std::move(topology));
 	}
 
 	Genome::Genome(const Genome& genomeToCopy)
-		: inputCount_(genomeToCopy.inputCount_), outputCount_(genomeToCopy.outputCount_)
+		: inputCount_(genomeToCopy.inputCount_), outputCount_(genomeToCopy.outputCount_), topology_(genomeToCopy.topology_),
+		values_(genomeToCopy.values_), sharedValues_(genomeToCopy.sharedValues_), collectionCount_(genomeToCopy.collectionCount_)
 	{
-		// Copy the node genes
-		for (const auto& node : genomeToCopy.nodeGenes_)
-			nodeGenes_.emplace_back(node);
+		// The node values aren't copied, since they are only valid during an evaluation.
+	}
 
-		// Copy the connection genes
-		for (const auto& [innovationNum, connection] : genomeToCopy.connectionGenes_)
-			addConnectionGene_assumeSafe(connection);
+	Genome& Genome::operator=(const Genome& genomeToCopy)
+	{
+		inputCount_ = genomeToCopy.inputCount_;
+		outputCount_ = genomeToCopy.outputCount_;
+		topology_ = genomeToCopy.topology_;
+		values_ = genomeToCopy.values_;
+		sharedValues_ = genomeToCopy.sharedValues_;
+		collectionCount_ = genomeToCopy.collectionCount_;
+		nodeValues_.clear();
+		outputsEvaluated_ = false;
+		invalidatePlan();
+
+		return *this;
 	}
 
 	Genome::Genome(const Genome& parent1, const Genome& parent2)
-		: inputCount_(parent1.inputCount_), outputCount_(parent1.outputCount_)
+		: inputCount_(parent1.inputCount_), outputCount_(parent1.outputCount_), topology_(parent1.topology_), collectionCount_(parent1.collectionCount_)
 	{
 		assert(parent1.inputCount_ == parent2.inputCount_ && "Input counts do not match between parents!");
 		assert(parent1.outputCount_ == parent2.outputCount_ && "Output counts do not match between parents!");
 
-		// Create the random number generator
-		std::random_device rd;
-		std::mt19937 gen(rd());
+		// The child's values are changed right away, so they aren't shared with parent1.
+		copyValuesFrom(parent1);
+
+		// Each thread keeps its own stream, so it's only seeded once.
+		thread_local RandomStream random{ randomSeed() };
+		inheritGenesFrom(parent2, random);
+	}
+
+	/// <summary>
+	/// The second half of crossover, for a genome that starts out as a copy of parent1 (the more fit parent).
+	/// Matching genes get the weight and expressed flag of a random parent, and a gene disabled in either parent has a 75% chance to be disabled in the child.
+	/// Excess and disjoint genes are kept from parent1, so the child keeps parent1's topology.
+	/// Both connection lists are sorted by innovation number, so they are merged in a single pass. The random decisions are made 64 genes at a time, as bitmasks.
+	/// </summary>
+	void Genome::inheritGenesFrom(const Genome& parent2, RandomStream& random)
+	{
+		assert(inputCount_ == parent2.inputCount_ && outputCount_ == parent2.outputCount_ && "Parents do not have the same inputs and outputs!");
+
+		invalidatePlan();
+		outputsEvaluated_ = false;
+
+		const auto& connections = topology_->connections_;
+		const auto& parent2Connections = parent2.topology_->connections_;
+		const size_t connectionCount = connections.size();
 
-		// Add all nodes from parent1
-		for (const auto& node : parent1.nodeGenes_)
-			nodeGenes_.emplace_back(node);
+		auto& values = mutableValues();
+		const auto& parent2Values = parent2.values();
 
-		// Go through each connection gene in parent1 and see if it also exists in parent2.
-		// If it does, add it to the genome.
-		// If it doesn't, add the excess/disjoint gene from parent1 (the more fit parent).
-		for (const auto& [innovationNum, connection] : parent1.connectionGenes_)
+		uint32_t parent2Indices[64];
+		size_t parent2Index = 0;
+		for (size_t blockBegin = 0; blockBegin < connectionCount; blockBegin += 64)
 		{
-			if (parent2.connectionGenes_.find(innovationNum) != parent2.connectionGenes_.end())
+			const size_t blockSize = std::min<size_t>(64, connectionCount - blockBegin);
+
+			// Find the matching genes of this block, and whether they are expressed in parent2.
+			uint64_t matching = 0;
+			uint64_t parent2Expressed = 0;
+			for (size_t i = 0; i < blockSize; i++)
 			{
-				if (std::uniform_int_distribution(0, 1)(gen))
-				{
-					connectionGenes_[innovationNum] = connection;
-				}
-				else
-				{
-					connectionGenes_[innovationNum] = parent2.connectionGenes_.at(innovationNum);
-				}
+				const uint32_t innovationNumber = connections[blockBegin + i].innovationNumber;
+				while (parent2Index < parent2Connections.size() && parent2Connections[parent2Index].innovationNumber < innovationNumber)
+					parent2Index++;
 
-				// If the gene is disabled in either parent, there is a 75% chance that it will also be disabled in the child.
-				if (!parent2.connectionGenes_.at(innovationNum).expressed_ || !connection.expressed_)
+				if (parent2Index < parent2Connections.size() && parent2Connections[parent2Index].innovationNumber == innovationNumber)
 				{
-					if (std::uniform_real_distribution<float>(0.0f, 1.0f)(gen) < 0.75f)
-						connectionGenes_[innovationNum].disable();
+					matching |= uint64_t{ 1 } << i;
+					parent2Expressed |= ((parent2Values.expressed[parent2Index / 64] >> (parent2Index % 64)) & 1u) << i;
+					parent2Indices[i] = static_cast<uint32_t>(parent2Index);
 				}
 			}
-			else
+
+			// One random bit per gene picks the parent, and two more are combined into a 75% chance.
+			uint64_t bits[2], moreBits[2];
+			random.nextBits(bits);
+			random.nextBits(moreBits);
+			const uint64_t fromParent2 = matching & bits[0];
+			const uint64_t disableChance = bits[1] | moreBits[0];
+
+			// Blocks start at a multiple of 64, so a block is exactly one word of expressed flags.
+			uint64_t& expressed = values.expressed[blockBegin / 64];
+			const uint64_t disabledInEither = matching & ~(expressed & parent2Expressed);
+			expressed = (expressed & ~fromParent2) | (parent2Expressed & fromParent2);
+			expressed &= ~(disabledInEither & disableChance);
+
+			for (uint64_t remaining = fromParent2; remaining != 0; remaining &= remaining - 1)
 			{
-				// Add the excess/disjoint gene from parent1
-				connectionGenes_[innovationNum] = connection;
+				const uint32_t i = countTrailingZeros(remaining);
+				values.weights[blockBegin + i] = parent2Values.weights[parent2Indices[i]];
 			}
 		}
-
-		reconnectIncommingPointers();
 	}
 
 	/// <summary>
@@ -157,14 +325,12 @@ namespace neat
 			addConnectionMutation();
 		}
 
-		reconnectIncommingPointers();
-
 		return *this;
 	}
 
 	Genome& Genome::addConnectionMutation()
 	{
-		assert(nodeGenes_.size() > 0 && "There are no node genes to add connections to!");
+		assert(topology_->nodeGenes_.size() > 0 && "There are no node genes to add connections to!");
 		assert(inputCount_ > 0 && "There are no input nodes!");
 		assert(outputCount_ > 0 && "There are no output nodes!");
 
@@ -172,93 +338,101 @@ namespace neat
 		std::random_device rd;
 		std::mt19937 gen(rd());
 
-		std::uniform_int_distribution<uint64_t> randomGen{ 0, nodeGenes_.size() - 1 };
 		std::uniform_real_distribution<float> randomFloatGen{ -2.0f, 2.0f };
 
-		// Determine in/out nodes
-		uint64_t node1 = randomGen(gen);
-		uint64_t node2 = randomGen(gen);
-		while (
-			node1 == node2 ||
-			(nodeGenes_[node1].type() == NodeGene::NodeType::INPUT && nodeGenes_[node2].type() == NodeGene::NodeType::INPUT) ||
-			(nodeGenes_[node1].type() == NodeGene::NodeType::OUTPUT && nodeGenes_[node2].type() == NodeGene::NodeType::OUTPUT)
-			)
-		{
-			node2 = randomGen(gen);
-		}
-
-		// Reverse connection if needed
+		// Connections can only go out of input (and bias) and hidden nodes, and into output and hidden nodes.
+		// Input and output nodes are stored contiguously, so these are indexed as: [inputs + bias, hidden] and [outputs, hidden].
+		const uint64_t inputAndBiasCount = inputCount_ + 1;
+		const uint64_t hiddenBegin = inputAndBiasCount + outputCount_;
+		const uint64_t hiddenCount = numberOfHiddenNodes();
+
+		const auto sourceNode = [&](uint64_t index) { return index < inputAndBiasCount ? index : hiddenBegin + (index - inputAndBiasCount); };
+		const auto targetNode = [&](uint64_t index) { return index < outputCount_ ? inputAndBiasCount + index : hiddenBegin + (index - outputCount_); };
+
+		// The genome is saturated, nothing can be added.
+		const auto& candidates = topology_->candidates_;
+		const int64_t freePairCount = candidates.freeTargetCounts.total();
+		if (freePairCount == 0)
+			return *this;
+
+		// Every pair that can be added is equally likely: the pair is picked by number, which falls into the count of one source, and is then the n-th target that source isn't blocked from.
+		int64_t n = 0;
+		const uint64_t source = candidates.freeTargetCounts.find(std::uniform_int_distribution<int64_t>{ 0, freePairCount - 1 }(gen), n);
+		const uint64_t* blocked = candidates.blockedTargets.data() + source * candidates.rowWords;
+		const uint64_t targetCount = outputCount_ + hiddenCount;
+
+		uint64_t target = 0;
+		for (size_t w = 0; w < candidates.rowWords; w++)
 		{
-			bool reversed = false; // connection goes from node 1 to 2 by default, but this might not be correct.
-			if (nodeGenes_[node2].type() == NodeGene::NodeType::INPUT)
-				reversed = true;
-			else if (nodeGenes_[node1].type() == NodeGene::NodeType::OUTPUT)
-				reversed = true;
+			uint64_t free = ~blocked[w];
+			if (64 * (w + 1) > targetCount)
+				free &= (uint64_t{ 1 } << (targetCount % 64)) - 1;
 
-			if (reversed)
+			const int64_t freeCount = countSetBits(free);
+			if (n >= freeCount)
 			{
-				uint64_t temp = node1;
-				node1 = node2;
-				node2 = temp;
+				n -= freeCount;
+				continue;
 			}
-		}
 
-		// Check if the connection already exists
-		auto existsIt = existingInnovations_s.find({ node1, node2 });
-		if (existsIt == existingInnovations_s.end())
-		{
-			// Connection does not exist
-			addConnectionGene(node1, node2, randomFloatGen(gen));
-		}
-		else
-		{
-			// Connection exists in the innovation space. Check if it also exists withing this genome.
-			if (connectionGenes_.find((*existsIt).second) != connectionGenes_.end())
-			{
-				// Connection exists in this genome.
-				return *this;
-			}
-			else
-			{
-				// Connection exists in the innovation space, but not in this genome.
-				// Add the connection to this genome.
-				connectionGenes_.emplace((*existsIt).second, ConnectionGene(node1, node2, randomFloatGen(gen), true, (*existsIt).second));
-				reconnectIncommingPointers();
-				return *this;
-			}
+			for (; n > 0; n--)
+				free &= free - 1;
+			target = 64 * w + countSetBits((free & (~free + 1)) - 1);
+			break;
 		}
 
+		// A candidate never creates a loop, so this only fails once the innovation numbers have run out.
+		addConnectionGene(sourceNode(source), targetNode(target), randomFloatGen(gen));
+
 		return *this;
 	}
 
 	Genome& Genome::addNodeMutation()
 	{
-		assert(connectionGenes_.size() != 0 && "There are no connection genes to split!");
+		assert(numberOfConnections() != 0 && "There are no connection genes to split!");
 
 		// Create the randomizer helpers
 		std::random_device rd;
 		std::mt19937 gen(rd());
 
-		std::uniform_int_distribution<uint64_t> randomGen{ 0, connectionGenes_.size() - 1 };
+		std::uniform_int_distribution<size_t> randomGen{ 0, numberOfConnections() - 1 };
 
 		// Determine the connection to split
-		size_t geneOffset = randomGen(gen);
-		auto it = connectionGenes_.begin();
-		for (size_t i = 0; i < geneOffset; i++)
-			it++;
-		ConnectionGene& connection = (*it).second;
+		const size_t connectionIndex = randomGen(gen);
 
-		// Split the connection
-		connection.disable();
+		const uint64_t node1 = topology_->connections_[connectionIndex].inNode;
+		const uint64_t node2 = topology_->connections_[connectionIndex].outNode;
+		const float weight = values().weights[connectionIndex];
+
+		// Genomes that split the same connection get the same node, and with it the same new connections.
+		// If this genome already has that node (it split the connection before), the new node gets an id of its own.
+		const auto& nodeIds = topology_->nodeIds_;
+		uint64_t newNodeId = innovationRegistry_s.getSplitNodeId(topology_->connections_[connectionIndex].innovationNumber);
+		if (std::find(nodeIds.begin(), nodeIds.end(), newNodeId) != nodeIds.end())
+			newNodeId = innovationRegistry_s.newNodeId();
+
+		// Once the innovation numbers have run out, the genome is left as it is.
+		const uint64_t inInnovationNumber = innovationRegistry_s.getInnovationNumber(nodeIds[node1], newNodeId);
+		const uint64_t outInnovationNumber = innovationRegistry_s.getInnovationNumber(newNodeId, nodeIds[node2]);
+		if (inInnovationNumber == InnovationRegistry::noInnovation_c || outInnovationNumber == InnovationRegistry::noInnovation_c)
+			return *this;
 
-		uint64_t node1 = connection.inNode();
-		uint64_t node2 = connection.outNode();
+		// Split the connection
+		invalidatePlan();
+		setConnectionExpressed(connectionIndex, false);
 
 		// Create the new node
-		nodeGenes_.emplace_back(NodeGene::NodeType::HIDDEN);
+		Topology topology = *topology_;
+		topology.nodeGenes_.emplace_back(NodeGene::NodeType::HIDDEN);
+		topology.nodeIds_.push_back(newNodeId);
+		addNodeToTopologicalOrder(topology);
+		addNodeToConnectionCandidates(topology);
+
+		const uint64_t newNode = topology.nodeGenes_.size() - 1;
+		addConnectionGene_assumeSafe(topology, node1, newNode, inInnovationNumber, 1.0f);
+		addConnectionGene_assumeSafe(topology, newNode, node2, outInnovationNumber, weight);
 
-		addConnectionGene_assumeSafe(node1, nodeGenes_.size() - 1, 1.0f);
-		addConnectionGene_assumeSafe(nodeGenes_.size() - 1, node2, connection.weight_);
+		topology_ = internTopology(std::move(topology));
 
 		return *this;
 	}
@@ -268,32 +442,270 @@ namespace neat
 	/// </summary>
 	Genome& Genome::mutateConnectionGenes()
 	{
-		// Create the randomizer helpers
-		std::random_device rd;
-		std::mt19937 gen(rd());
+		// Each thread keeps its own stream, so it's only seeded once.
+		thread_local RandomStream random{ randomSeed() };
+
+		invalidatePlan();
+		auto& weights = mutableValues().weights;
+		mutateWeights(weights.data(), weights.size(), random);
 
+		return *this;
+	}
 
-		// Mutate all connection genes
-		for (auto& connection : connectionGenes_)
+	void Genome::mutateConnectionGenes(const std::vector<Genome*>& genomes, ThreadPool* threadPool)
+	{
+		size_t totalWeightCount = 0;
+		for (const auto* genome : genomes)
+			totalWeightCount += genome->numberOfConnections();
+
+		// Every range gets its own random stream, numbered by its first genome.
+		const uint64_t seed = randomSeed();
+		const auto mutateRange = [&genomes, seed](size_t begin, size_t end)
 		{
-			// 10% chance to reset the weight
-			if (std::uniform_real_distribution<float>(0.0f, 1.0f)(gen) < 0.1f)
+			RandomStream random{ seed, begin };
+			for (size_t i = begin; i < end; i++)
 			{
-				connection.second.weight_ = std::uniform_real_distribution<float>(-12.0f, 12.0f)(gen);
+				genomes[i]->invalidatePlan();
+				auto& weights = genomes[i]->mutableValues().weights;
+				mutateWeights(weights.data(), weights.size(), random);
 			}
-			else // 90% change to perturb the weight
+		};
+
+		if (threadPool)
+			threadPool->parallelForRanges(genomes.size(), mutateRange, grainSize(genomes.size(), totalWeightCount, minWeightsPerTask_c));
+		else
+			mutateRange(0, genomes.size());
+	}
+
+	void Genome::crossover(const std::vector<std::pair<const Genome*, const Genome*>>& parents, std::vector<Genome>& children, size_t firstChild, ThreadPool* threadPool)
+	{
+		// The children are placed first, so the threads only have to fill them in. Parents may live in children, outside the children's range, as long as it doesn't have to grow.
+		if (children.size() < firstChild + parents.size())
+			children.resize(firstChild + parents.size(), Genome{});
+
+		size_t totalGeneCount = 0;
+		for (const auto& [parent1, parent2] : parents)
+			totalGeneCount += parent1->numberOfConnections();
+
+		const uint64_t seed = randomSeed();
+		const auto breedRange = [&parents, &children, firstChild, seed](size_t begin, size_t end)
+		{
+			RandomStream random{ seed, begin };
+			for (size_t i = begin; i < end; i++)
+				children[firstChild + i].breedFrom(*parents[i].first, *parents[i].second, random);
+		};
+
+		if (threadPool)
+			threadPool->parallelForRanges(parents.size(), breedRange, grainSize(parents.size(), totalGeneCount, minGenesPerTask_c));
+		else
+			breedRange(0, parents.size());
+	}
+
+	Genome& Genome::breedFrom(const Genome& parent1, const Genome& parent2)
+	{
+		// Each thread keeps its own stream, so it's only seeded once.
+		thread_local RandomStream random{ randomSeed() };
+		breedFrom(parent1, parent2, random);
+
+		return *this;
+	}
+
+	void Genome::breedFrom(const Genome& parent1, const Genome& parent2, RandomStream& random)
+	{
+		assert(parent1.inputCount_ == parent2.inputCount_ && "Input counts do not match between parents!");
+		assert(parent1.outputCount_ == parent2.outputCount_ && "Output counts do not match between parents!");
+
+		// The child's values are overwritten in place (instead of shared with parent1), since they are changed right away.
+		inputCount_ = parent1.inputCount_;
+		outputCount_ = parent1.outputCount_;
+		topology_ = parent1.topology_;
+		collectionCount_ = parent1.collectionCount_;
+		copyValuesFrom(parent1);
+		inheritGenesFrom(parent2, random);
+	}
+
+	/// <summary>
+	/// Resets (10% chance) or perturbs (90% chance) every weight. Four weights are mutated at a time, with SSE where available.
+	/// </summary>
+	void Genome::mutateWeights(float* weights, size_t count, RandomStream& random)
+	{
+		size_t i = 0;
+
+#if defined(NEAT_SSE_ENABLED)
+		const __m128 resetChance = _mm_set1_ps(weightResetChance_c);
+		const __m128 resetScale = _mm_set1_ps(2.0f * weightResetRange_c);
+		const __m128 resetOffset = _mm_set1_ps(-weightResetRange_c);
+		const __m128 perturbScale = _mm_set1_ps(2.0f * weightPerturbRange_c);
+		const __m128 perturbOffset = _mm_set1_ps(-weightPerturbRange_c);
+		for (; i + 4 <= count; i += 4)
+		{
+			const __m128 choices = random.nextFloats();
+			const __m128 values = random.nextFloats();
+			const __m128 weight = _mm_loadu_ps(weights + i);
+
+			const __m128 resetWeight = _mm_add_ps(_mm_mul_ps(values, resetScale), resetOffset);
+			const __m128 perturbedWeight = _mm_add_ps(weight, _mm_add_ps(_mm_mul_ps(values, perturbScale), perturbOffset));
+
+			const __m128 reset = _mm_cmplt_ps(choices, resetChance);
+			_mm_storeu_ps(weights + i, _mm_or_ps(_mm_and_ps(reset, resetWeight), _mm_andnot_ps(reset, perturbedWeight)));
+		}
+#endif
+
+		// Any remaining weights (or all of them, without SSE).
+		float choices[4];
+		float values[4];
+		for (; i < count; i += 4)
+		{
+			random.nextFloats(choices);
+			random.nextFloats(values);
+			for (size_t j = 0; j < 4 && i + j < count; j++)
 			{
-				connection.second.weight_ += std::uniform_real_distribution<float>(-5.0f, 5.0f)(gen);
+				if (choices[j] < weightResetChance_c)
+					weights[i + j] = (2.0f * values[j] - 1.0f) * weightResetRange_c;
+				else
+					weights[i + j] += (2.0f * values[j] - 1.0f) * weightPerturbRange_c;
 			}
 		}
+	}
+
+	Genome& Genome::addHiddenNode()
+	{
+		invalidatePlan();
+
+		Topology topology = *topology_;
+		topology.nodeGenes_.push_back(NodeGene::NodeType::HIDDEN);
+		topology.nodeIds_.push_back(innovationRegistry_s.newNodeId());
+		addNodeToTopologicalOrder(topology);
+		addNodeToConnectionCandidates(topology);
+
+		topology_ = internTopology(std::move(topology));
 
 		return *this;
 	}
 
-	Genome& Genome::addHiddenNode()
+	Genome& Genome::collectGarbage(uint32_t maxDisabledGenerations)
 	{
-		nodeGenes_.push_back(NodeGene::NodeType::HIDDEN);
-		reconnectIncommingPointers();
+		const auto& oldTopology = *topology_;
+		const auto& connections = oldTopology.connections_;
+		const auto& nodeGenes = oldTopology.nodeGenes_;
+
+		// Every genome is collected each generation, so each thread keeps its scratch space instead of allocating it every time.
+		thread_local std::vector<bool> keepConnection;
+		thread_local std::vector<bool> keepNode;
+		thread_local std::vector<uint32_t> newNodeIndex;
+
+		// Find the connections that have been disabled for too long. Connections only remember the call in which they were first found disabled,
+		// so the values only change when a connection is disabled or enabled, and copies that share their values keep sharing them otherwise.
+		collectionCount_ = collectionCount_ == UINT16_MAX ? 1 : collectionCount_ + 1;
+		keepConnection.assign(connections.size(), true);
+		bool removeAny = false;
+		for (size_t i = 0; i < connections.size(); i++)
+		{
+			uint16_t disabledSince = values().disabledSince[i];
+			if (isConnectionExpressed(i))
+			{
+				if (disabledSince != 0)
+					mutableValues().disabledSince[i] = 0;
+				continue;
+			}
+
+			if (disabledSince == 0)
+			{
+				disabledSince = collectionCount_;
+				mutableValues().disabledSince[i] = disabledSince;
+			}
+
+			// The number of calls the connection has been disabled for, including this one. The call numbers wrap around, so this is at most UINT16_MAX.
+			const uint32_t disabledCalls = (collectionCount_ + UINT16_MAX - disabledSince) % UINT16_MAX + 1;
+			if (disabledCalls > maxDisabledGenerations)
+			{
+				keepConnection[i] = false;
+				removeAny = true;
+			}
+		}
+
+		// Find the nodes that still have a path to an output, by walking the topological order backwards from the outputs.
+		keepNode.assign(nodeGenes.size(), false);
+		for (size_t i = 0; i < nodeGenes.size(); i++)
+			keepNode[i] = nodeGenes[i].type_ != NodeGene::NodeType::HIDDEN;
+
+		for (auto it = oldTopology.topologicalOrder_.rbegin(); it != oldTopology.topologicalOrder_.rend(); it++)
+		{
+			if (!keepNode[*it] || nodeGenes[*it].type_ == NodeGene::NodeType::INPUT)
+				continue;
+
+			for (auto connIndex : nodeGenes[*it].incomming_)
+			{
+				if (keepConnection[connIndex])
+					keepNode[connections[connIndex].inNode] = true;
+			}
+		}
+
+		// Connections into removed nodes are removed as well.
+		for (size_t i = 0; i < connections.size(); i++)
+		{
+			if (keepConnection[i] && !keepNode[connections[i].outNode])
+			{
+				keepConnection[i] = false;
+				removeAny = true;
+			}
+		}
+
+		if (!removeAny)
+			return *this;
+
+		// Compact the node indices. Input, bias and output nodes always come first, so they keep their indices.
+		// Innovations are keyed on the node ids, which are kept, so the new indices don't change which innovations the nodes' connections get.
+		newNodeIndex.assign(nodeGenes.size(), UINT32_MAX);
+		Topology topology;
+		for (size_t i = 0; i < nodeGenes.size(); i++)
+		{
+			if (!keepNode[i])
+				continue;
+
+			newNodeIndex[i] = static_cast<uint32_t>(topology.nodeGenes_.size());
+			topology.nodeGenes_.emplace_back(nodeGenes[i].type_);
+			topology.nodeIds_.push_back(oldTopology.nodeIds_[i]);
+		}
+
+		for (auto node : oldTopology.topologicalOrder_)
+		{
+			if (keepNode[node])
+				topology.topologicalOrder_.push_back(newNodeIndex[node]);
+		}
+		topology.nodeOrder_.resize(topology.topologicalOrder_.size());
+		for (size_t i = 0; i < topology.topologicalOrder_.size(); i++)
+			topology.nodeOrder_[topology.topologicalOrder_[i]] = i;
+
+		// Compact the connections, along with their weights, expressed flags and ages. 
+		// The per-genome arrays are compacted in place: a kept connection only ever moves down, onto an index that has already been read.
+		auto& values = mutableValues();
+		size_t keptCount = 0;
+		for (size_t i = 0; i < connections.size(); i++)
+		{
+			if (!keepConnection[i])
+				continue;
+
+			topology.connections_.push_back({ newNodeIndex[connections[i].inNode], newNodeIndex[connections[i].outNode], connections[i].innovationNumber });
+			values.weights[keptCount] = values.weights[i];
+			values.disabledSince[keptCount] = values.disabledSince[i];
+			setExpressed(values, keptCount, (values.expressed[i / 64] >> (i % 64)) & 1u);
+			keptCount++;
+		}
+
+		values.weights.resize(keptCount);
+		values.disabledSince.resize(keptCount);
+		values.expressed.resize((keptCount + 63) / 64);
+		// The bits past the last connection must stay 0.
+		if (keptCount % 64 != 0)
+			values.expressed.back() &= (uint64_t{ 1 } << (keptCount % 64)) - 1;
+
+		reconnectIncommingPointers(topology);
+		buildConnectionCandidates(topology);
+		topology_ = internTopology(std::move(topology));
+
+		invalidatePlan();
+		outputsEvaluated_ = false;
 
 		return *this;
 	}
@@ -304,57 +716,173 @@ namespace neat
 	/// <returns>True if the connection was added. False if the connection was not added, due to it creating a loop. </returns>
 	bool Genome::addConnectionGene(uint64_t inNode, uint64_t outNode, float weight, bool expressed)
 	{
+		// An existing connection only gets its weight and expressed flag replaced, which leaves the topology as it is.
+		const size_t existingIndex = findConnectionBetween(inNode, outNode);
+		if (existingIndex != numberOfConnections())
 		{
-			std::unordered_set<uint64_t> traversedNodes{ inNode };
-			std::unordered_set<uint64_t> newNodes = { inNode };
+			invalidatePlan();
+			auto& values = mutableValues();
+			values.weights[existingIndex] = weight;
+			setExpressed(values, existingIndex, expressed);
+			values.disabledSince[existingIndex] = 0;
+			return true;
+		}
 
-			while (newNodes.size())
-			{
-				std::unordered_set<uint64_t> temp;
+		// The connection is checked against the shared topology, so the topology is only copied if the connection is accepted.
+		thread_local OrderUpdate update;
+		if (!findOrderUpdate(*topology_, inNode, outNode, update))
+			return false;
 
-				for (uint64_t node : newNodes)
-				{
-					for (const auto& connGene : nodeGenes_[node].incomming_)
-					{
-						traversedNodes.insert(connGene->inNode_);
-						temp.insert(connGene->inNode_);
-					}
-				}
+		// Identical connections added within the same generation share their innovation number, whatever the nodes' indices are in each genome.
+		const uint64_t innovationNumber = innovationRegistry_s.getInnovationNumber(topology_->nodeIds_[inNode], topology_->nodeIds_[outNode]);
+		if (innovationNumber == InnovationRegistry::noInnovation_c)
+			return false;
 
-				newNodes = temp;
-			}
+		Topology topology = *topology_;
+		applyOrderUpdate(topology, update);
 
-			if (traversedNodes.find(outNode) != traversedNodes.end())
-				return false;
-		}
+		invalidatePlan();
+		addConnectionGene_assumeSafe(topology, inNode, outNode, innovationNumber, weight, expressed);
 
-		addConnectionGene_assumeSafe(inNode, outNode, weight, expressed);
+		topology_ = internTopology(std::move(topology));
 
 		return true;
 	}
 
 	/// <summary>
-	/// Adds a connection gene to the network. This method assumes that the connection gene won't create an infinite loop. 
+	/// Adds a connection gene with the given innovation number (from the innovation registry) to a (not yet interned) topology. This method assumes that the connection gene won't create an infinite loop. 
+	/// </summary>
+	void Genome::addConnectionGene_assumeSafe(Topology& topology, uint64_t inNode, uint64_t outNode, uint64_t innovationNumber, float weight, bool expressed)
+	{
+		// Keep the topological order valid. This is a no-op if the order already is.
+		[[maybe_unused]] const bool acyclic = insertIntoTopologicalOrder(topology, inNode, outNode);
+		assert(acyclic && "Connection gene creates a loop!");
+
+		assert(inNode <= UINT32_MAX && outNode <= UINT32_MAX && innovationNumber < InnovationRegistry::maxInnovationCount_c && "Connection does not fit in the topology!");
+		insertConnection(topology, { static_cast<uint32_t>(inNode), static_cast<uint32_t>(outNode), static_cast<uint32_t>(innovationNumber) }, weight, expressed);
+		addConnectionToCandidates(topology, inNode, outNode);
+	}
+
+	/// <summary>
+	/// Inserts a connection at its sorted position (replacing any connection with the same innovation number), along with its weight and expressed flag, and updates the node connections.
 	/// </summary>
-	void Genome::addConnectionGene_assumeSafe(uint64_t inNode, uint64_t outNode, float weight, bool expressed)
+	void Genome::insertConnection(Topology& topology, const Topology::Connection& connection, float weight, bool expressed)
 	{
-		uint64_t connectionInnovationNumber;
+		auto& connections = topology.connections_;
+		auto& values = mutableValues();
 
-		if (existingInnovations_s.find({ inNode, outNode }) != existingInnovations_s.end())
-			connectionInnovationNumber = existingInnovations_s[{inNode, outNode}];
+		// New innovations are almost always the newest, so this is usually an append.
+		if (connections.empty() || connections.back().innovationNumber < connection.innovationNumber)
+		{
+			connections.push_back(connection);
+			topology.nodeGenes_[connection.outNode].incomming_.push_back(static_cast<uint32_t>(connections.size() - 1));
+			topology.nodeGenes_[connection.inNode].outgoing_.push_back(static_cast<uint32_t>(connections.size() - 1));
+
+			values.weights.push_back(weight);
+			insertExpressedFlag(values, values.weights.size() - 1, expressed);
+			values.disabledSince.push_back(0);
+			shareValuesIfLarge();
+			return;
+		}
+
+		auto it = std::lower_bound(connections.begin(), connections.end(), connection.innovationNumber,
+			[](const Topology::Connection& connection, uint32_t innovationNumber) { return connection.innovationNumber < innovationNumber; });
+		const size_t index = it - connections.begin();
+		if (it != connections.end() && it->innovationNumber == connection.innovationNumber)
+		{
+			*it = connection;
+			values.weights[index] = weight;
+			setExpressed(values, index, expressed);
+			values.disabledSince[index] = 0;
+		}
 		else
-			connectionInnovationNumber = ConnectionGene::currentInnovationNumber_s++;
+		{
+			connections.insert(it, connection);
+			values.weights.insert(values.weights.begin() + index, weight);
+			insertExpressedFlag(values, index, expressed);
+			values.disabledSince.insert(values.disabledSince.begin() + index, 0);
+			shareValuesIfLarge();
+		}
 
-		connectionGenes_[connectionInnovationNumber] = { inNode, outNode, weight, expressed, connectionInnovationNumber };
-		reconnectIncommingPointers();
-		//nodeGenes_[outNode].incomming_.push_back(&connectionGenes_[connectionInnovationNumber]);
+		// The indices of the following connections have shifted.
+		reconnectIncommingPointers(topology);
 	}
 
-	void Genome::addConnectionGene_assumeSafe(const ConnectionGene& gene)
+	/// <summary>
+	/// Inserts an expressed flag at the given index, moving the flags after it up by one. Must be called after the weight was inserted.
+	/// </summary>
+	void Genome::insertExpressedFlag(ConnectionValues& values, size_t connectionIndex, bool expressed)
+	{
+		const size_t connectionCount = values.weights.size();
+		values.expressed.resize((connectionCount + 63) / 64, 0);
+
+		for (size_t i = connectionCount - 1; i > connectionIndex; i--)
+			setExpressed(values, i, (values.expressed[(i - 1) / 64] >> ((i - 1) % 64)) & 1u);
+
+		setExpressed(values, connectionIndex, expressed);
+	}
+
+	Genome::ConnectionValues& Genome::mutableValues()
+	{
+		if (!sharedValues_)
+			return values_;
+
+		// Only this genome uses the values (and any genome that used them before is done reading them).
+		if (sharedValues_.isUnique())
+			return *sharedValues_;
+
+		// Another genome still uses the values, so this genome gets its own copy. Values that fit inline again go back inline.
+		if (sharedValues_->weights.size() <= inlineConnectionCount_c)
+		{
+			values_ = *sharedValues_;
+			sharedValues_.reset();
+			return values_;
+		}
+
+		sharedValues_ = SharedValues{ ConnectionValues{ *sharedValues_ } };
+		return *sharedValues_;
+	}
+
+	void Genome::copyValuesFrom(const Genome& other)
+	{
+		const auto& otherValues = other.values();
+		if (sharedValues_ && sharedValues_ == other.sharedValues_)
+		{
+			// Already the same values, but about to change.
+			sharedValues_ = SharedValues{ ConnectionValues{ otherValues } };
+		}
+		else if (sharedValues_ && sharedValues_.isUnique())
+		{
+			// This genome's own block (and its heap storage) is reused.
+			*sharedValues_ = otherValues;
+		}
+		else
+		{
+			sharedValues_.reset();
+			values_ = otherValues;
+			shareValuesIfLarge();
+		}
+	}
+
+	/// <summary>
+	/// Moves the connection values into a shared block once they outgrow the inline storage, so copies of the genome can share them.
+	/// </summary>
+	void Genome::shareValuesIfLarge()
+	{
+		if (sharedValues_ || values_.weights.size() <= inlineConnectionCount_c)
+			return;
+
+		// Moving leaves values_ empty.
+		sharedValues_ = SharedValues{ std::move(values_) };
+	}
+
+	/// <summary>
+	/// Assembles the full connection gene at the given index from the topology and this genome's weights and expressed flags.
+	/// </summary>
+	Genome::ConnectionGene Genome::getConnectionGene(size_t connectionIndex) const
 	{
-		connectionGenes_[gene.innovationNumber_] = { gene.inNode_, gene.outNode_, gene.weight_, gene.expressed_, gene.innovationNumber_ };
-		reconnectIncommingPointers();
-		//nodeGenes_[gene.outNode_].incomming_.push_back(&connectionGenes_[gene.innovationNumber_]);
+		const auto& connection = topology_->connections_[connectionIndex];
+		return { connection.inNode, connection.outNode, values().weights[connectionIndex], isConnectionExpressed(connectionIndex), connection.innovationNumber };
 	}
 
 	/// <summary>
@@ -362,58 +890,174 @@ namespace neat
 	/// </summary>
 	float Genome::calculateCompatibilityDistance(const Genome& other, const float excessConst, const float disjointConst, const float weightDiffConst) const
 	{
-		uint64_t largestInnovationNum = 0;
+		return calculateCompatibilityDistance(other, excessConst, disjointConst, weightDiffConst, std::numeric_limits<float>::infinity());
+	}
+
+	/// <summary>
+	/// Calculates the compatibility distance (delta) between this Genome and another, but stops as soon as the excess and disjoint genes alone reach the cutoff.
+	/// The constants must not be negative.
+	/// </summary>
+	/// <returns>The compatibility distance if it is below the cutoff. Otherwise some value greater than or equal to the cutoff. </returns>
+	float Genome::calculateCompatibilityDistance(const Genome& other, const float excessConst, const float disjointConst, const float weightDiffConst, const float cutoff) const
+	{
+		assert(excessConst >= 0 && disjointConst >= 0 && weightDiffConst >= 0 && "Compatibility constants must not be negative!");
+
+		const auto& connections = topology_->connections_;
+		const auto& otherConnections = other.topology_->connections_;
+		const auto& ownWeights = values().weights;
+		const auto& otherOwnWeights = other.values().weights;
+
+		// Genomes with the same topology only differ in their weights, which can be compared directly.
+		if (sharesTopologyWith(other) && !ownWeights.empty())
+			return weightDiffConst * (sumAbsoluteDifferences(ownWeights.data(), otherOwnWeights.data(), ownWeights.size()) / ownWeights.size());
+
+		const size_t N = std::max(connections.size(), otherConnections.size());
+		// The excess/disjoint term only grows while scanning, so the scan can stop once it reaches this.
+		const float structuralLimit = cutoff * N;
 
-		// Find the largest innovation number in this genome
-		for (const auto& [innovationNum, gene] : connectionGenes_)
-			largestInnovationNum = std::max(innovationNum, largestInnovationNum);
+		// The gene counts and signatures can prove that there are enough non-matching genes to rule out compatibility, without walking through the genes.
+		const float lowerBound = compatibilityDistanceLowerBound(other, excessConst, disjointConst);
+		if (lowerBound >= cutoff)
+			return lowerBound;
+
+		// The largest innovation number in this genome
+		const uint64_t largestInnovationNum = connections.empty() ? 0 : connections.back().innovationNumber;
+
+		// Weights of the matching genes are gathered into small buffers, and summed in batches with SIMD.
+		std::array<float, weightBatchSize_c> weights;
+		std::array<float, weightBatchSize_c> otherWeights;
+		size_t batchCount = 0;
 
 		float weightDifference = 0;
 		size_t matchingGeneCount = 0, disjointGeneCount = 0, excessGeneCount = 0;
-		// Go through each gene in this genome, and find any disjoint and matching genes.
-		for (const auto& [innovationNum, gene] : connectionGenes_)
+		const auto partialDistanceReached = [&]() { return N > 0 && excessConst * excessGeneCount + disjointConst * disjointGeneCount >= structuralLimit; };
+		const auto partialDistance = [&]() { return (excessConst * excessGeneCount) / N + (disjointConst * disjointGeneCount) / N; };
+
+		// Walk through both (sorted) connection lists side by side, and find the matching, disjoint and excess genes.
+		size_t index = 0, otherIndex = 0;
+		while (index < connections.size() && otherIndex < otherConnections.size())
 		{
-			if (other.connectionGenes_.find(innovationNum) != other.connectionGenes_.end()) // Matching gene
+			if (connections[index].innovationNumber == otherConnections[otherIndex].innovationNumber) // Matching gene
 			{
-				weightDifference += std::abs(gene.weight_ - other.connectionGenes_.at(innovationNum).weight_);
+				weights[batchCount] = ownWeights[index];
+				otherWeights[batchCount] = otherOwnWeights[otherIndex];
+				if (++batchCount == weightBatchSize_c)
+				{
+					weightDifference += sumAbsoluteDifferences(weights.data(), otherWeights.data(), batchCount);
+					batchCount = 0;
+				}
+
 				matchingGeneCount++;
+				index++;
+				otherIndex++;
+				continue;
 			}
-			else // Disjoint gene
+			
+			if (connections[index].innovationNumber < otherConnections[otherIndex].innovationNumber) // Disjoint gene in this genome
 			{
 				disjointGeneCount++;
+				index++;
 			}
+			else // not a matching gene in the other genome (always below the largest innovation number in this genome)
+			{
+				disjointGeneCount++;
+				otherIndex++;
+			}
+
+			if (partialDistanceReached())
+				return partialDistance();
 		}
 
-		// Go through each gene in the other genome, and find any excess genes
-		for (const auto& [innovationNum, gene] : other.connectionGenes_)
+		// Any genes left in this genome are disjoint.
+		disjointGeneCount += connections.size() - index;
+
+		// Any genes left in the other genome are past the largest innovation number in this genome, so they are excess genes (unless equal to it).
+		for (; otherIndex < otherConnections.size(); otherIndex++)
 		{
-			if (connectionGenes_.find(innovationNum) == connectionGenes_.end()) // not a matching gene
-			{
-				if (innovationNum < largestInnovationNum)
-					disjointGeneCount++;
-				else
-					excessGeneCount++;
-			}
+			if (otherConnections[otherIndex].innovationNumber < largestInnovationNum)
+				disjointGeneCount++;
+			else
+				excessGeneCount++;
 		}
 
+		if (partialDistanceReached())
+			return partialDistance();
+
+		weightDifference += sumAbsoluteDifferences(weights.data(), otherWeights.data(), batchCount);
+
 		// Calculate the compatibility distance
-		size_t N = std::max(connectionGenes_.size(), other.connectionGenes_.size());
 		return
 			(excessConst * excessGeneCount) / N +
 			(disjointConst * disjointGeneCount) / N +
 			weightDiffConst * (weightDifference / matchingGeneCount);
 	}
 
+	uint64_t Genome::hash() const
+	{
+		// Interned topologies already have a structural hash.
+		uint64_t hash = topology_->hash_;
+		for (float weight : values().weights)
+		{
+			uint32_t weightBits;
+			std::memcpy(&weightBits, &weight, sizeof(weightBits));
+			combineHash(hash, weightBits);
+		}
+		for (uint64_t expressedBits : values().expressed)
+			combineHash(hash, expressedBits);
+
+		return hash;
+	}
+
+	bool Genome::operator==(const Genome& other) const
+	{
+		// Topologies are interned, so equal structures are the same topology. Weights are compared bit by bit (like the hash), unless the values are shared.
+		const auto& ownValues = values();
+		const auto& otherValues = other.values();
+		return
+			topology_ == other.topology_ &&
+			(&ownValues == &otherValues ||
+				(ownValues.expressed == otherValues.expressed &&
+				(ownValues.weights.empty() || std::memcmp(ownValues.weights.data(), otherValues.weights.data(), ownValues.weights.size() * sizeof(float)) == 0)));
+	}
+
+	/// <summary>
+	/// Sums |a[i] - b[i]| over two float arrays, 4 elements at a time where SSE is available.
+	/// </summary>
+	float Genome::sumAbsoluteDifferences(const float* a, const float* b, size_t count)
+	{
+		float sum = 0;
+		size_t i = 0;
+
+#if defined(NEAT_SSE_ENABLED)
+		const __m128 signMask = _mm_set1_ps(-0.0f);
+		__m128 sumVector = _mm_setzero_ps();
+		for (; i + 4 <= count; i += 4)
+		{
+			const __m128 difference = _mm_sub_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i));
+			sumVector = _mm_add_ps(sumVector, _mm_andnot_ps(signMask, difference));
+		}
+
+		alignas(16) float lanes[4];
+		_mm_store_ps(lanes, sumVector);
+		sum = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+#endif
+
+		for (; i < count; i++)
+			sum += std::abs(a[i] - b[i]);
+
+		return sum;
+	}
+
 	/// <summary>
 	/// Determines whether a connection gene is present in the Genome
 	/// </summary>
-	/// <returns>A boolean to indicate whether it was found and a reference to the gene, if it was found. If the gene was not found, the reference simply points to the input parameter. </returns>
-	std::pair<bool, const Genome::ConnectionGene&> Genome::hasConnection_get(const ConnectionGene& gene) const
+	/// <returns>A boolean to indicate whether it was found and the gene (as stored in this genome), if it was found. If the gene was not found, this is simply a copy of the input parameter. </returns>
+	std::pair<bool, Genome::ConnectionGene> Genome::hasConnection_get(const ConnectionGene& gene) const
 	{
-		auto geneIt = connectionGenes_.find(gene.innovationNumber_);
-		if (geneIt == connectionGenes_.end())
+		const size_t index = findConnection(gene.innovationNumber());
+		if (index == numberOfConnections())
 			return { false, gene };
-		return { true, geneIt->second };
+		return { true, getConnectionGene(index) };
 	}
 
 	/// <summary>
@@ -421,17 +1065,109 @@ namespace neat
 	/// </summary>
 	bool Genome::hasConnection(const ConnectionGene& gene) const
 	{
-		auto geneIt = connectionGenes_.find(gene.innovationNumber_);
-		return geneIt != connectionGenes_.end();
+		return findConnection(gene.innovationNumber()) != numberOfConnections();
+	}
+
+	/// <summary>
+	/// Finds a connection by its innovation number (binary search).
+	/// </summary>
+	size_t Genome::findConnection(uint64_t innovationNumber) const
+	{
+		const auto& connections = topology_->connections_;
+		auto it = std::lower_bound(connections.begin(), connections.end(), innovationNumber,
+			[](const Topology::Connection& connection, uint64_t innovationNumber) { return connection.innovationNumber < innovationNumber; });
+		if (it == connections.end() || it->innovationNumber != innovationNumber)
+			return connections.size();
+		return it - connections.begin();
+	}
+
+	/// <summary>
+	/// Finds the connection going directly from inNode to outNode.
+	/// </summary>
+	size_t Genome::findConnectionBetween(uint64_t inNode, uint64_t outNode) const
+	{
+		const auto& connections = topology_->connections_;
+
+		// Only the shorter of the two adjacency lists has to be searched.
+		const auto& outgoing = topology_->nodeGenes_[inNode].outgoing_;
+		const auto& incomming = topology_->nodeGenes_[outNode].incomming_;
+		if (outgoing.size() <= incomming.size())
+		{
+			auto it = std::find_if(outgoing.begin(), outgoing.end(), [&](uint32_t connIndex) { return connections[connIndex].outNode == outNode; });
+			return it == outgoing.end() ? connections.size() : *it;
+		}
+		else
+		{
+			auto it = std::find_if(incomming.begin(), incomming.end(), [&](uint32_t connIndex) { return connections[connIndex].inNode == inNode; });
+			return it == incomming.end() ? connections.size() : *it;
+		}
+	}
+
+	uint64_t Genome::numberOfPossibleConnections() const
+	{
+		const uint64_t inputAndBiasCount = inputCount_ + 1;
+		const uint64_t hiddenCount = numberOfHiddenNodes();
+
+		// Inputs (and the bias) connect to outputs and hidden nodes, hidden nodes connect to outputs, 
+		// and every pair of hidden nodes can be connected in one direction.
+		return
+			inputAndBiasCount * outputCount_ +
+			inputAndBiasCount * hiddenCount +
+			hiddenCount * outputCount_ +
+			hiddenCount * (hiddenCount - 1) / 2;
+	}
+
+	uint64_t Genome::numberOfExpressedConnections() const
+	{
+		// The bits past the last connection are always 0.
+		uint64_t count = 0;
+		for (uint64_t expressedBits : values().expressed)
+			count += countSetBits(expressedBits);
+
+		return count;
+	}
+
+	/// <summary>
+	/// Every gene that isn't matching is an excess or disjoint gene, so the distance is at least min(excessConst, disjointConst) * (non-matching genes) / N.
+	/// A genome has at least as many genes the other doesn't have as the bits only its signature has, and as the number of genes it has more than the other.
+	/// </summary>
+	float Genome::compatibilityDistanceLowerBound(const Genome& other, const float excessConst, const float disjointConst) const
+	{
+		const size_t count = numberOfConnections();
+		const size_t otherCount = other.numberOfConnections();
+		const size_t N = std::max(count, otherCount);
+		if (N == 0)
+			return 0.0f;
+
+		// Signatures have a power of two words and bit = hash % bits, so word i of the larger one maps onto word i % size of the smaller one.
+		const bool largerHere = topology_->signature_.size() > other.topology_->signature_.size();
+		const auto& larger = largerHere ? topology_->signature_ : other.topology_->signature_;
+		const auto& smaller = largerHere ? other.topology_->signature_ : topology_->signature_;
+		size_t onlyLargerBits = 0, onlySmallerBits = 0;
+		for (size_t i = 0; i < smaller.size(); i++)
+		{
+			uint64_t folded = 0;
+			for (size_t j = i; j < larger.size(); j += smaller.size())
+				folded |= larger[j];
+
+			onlyLargerBits += countSetBits(folded & ~smaller[i]);
+			onlySmallerBits += countSetBits(smaller[i] & ~folded);
+		}
+		const size_t onlyHereBits = largerHere ? onlyLargerBits : onlySmallerBits;
+		const size_t onlyThereBits = largerHere ? onlySmallerBits : onlyLargerBits;
+
+		const size_t onlyHere = std::max(onlyHereBits, count > otherCount ? count - otherCount : 0);
+		const size_t onlyThere = std::max(onlyThereBits, otherCount > count ? otherCount - count : 0);
+
+		return std::min(excessConst, disjointConst) * (onlyHere + onlyThere) / N;
 	}
 
 	/// <summary>
-	/// Resets the network cache. SHOULD ALMOST ALWAYS BE CALLED BEFORE "evaluateOutputNodes"!
+	/// Marks the outputs as not evaluated. No longer needed before evaluateOutputNodes, since every node is evaluated each time, but kept for existing callers.
 	/// </summary>
 	void Genome::resetCache()
 	{
-		for (auto& node : nodeGenes_)
-			node.resetCache();
+		outputsEvaluated_ = false;
 	}
 
 	void Genome::setInputValues(const std::vector<float>& values)
@@ -441,26 +1177,43 @@ namespace neat
 
 		//assert(values.size() != inputCount_ && "Number of input nodes doesn't match number of values given!");
 
+		prepareNodeValues();
+
 		for (size_t i = 0; i < values.size(); i++)
 		{
-			assert(nodeGenes_[i].type_ == NodeGene::NodeType::INPUT && "Node is not an input node!");
+			assert(topology_->nodeGenes_[i].type_ == NodeGene::NodeType::INPUT && "Node is not an input node!");
 
-			nodeGenes_[i].value_ = values[i];
-			nodeGenes_[i].cached_ = true;
+			nodeValues_[i] = values[i];
 		}
 
 		// Set the bias node's value
-		nodeGenes_[inputCount_].value_ = 1.0f;
-		nodeGenes_[inputCount_].cached_ = true;
+		nodeValues_[inputCount_] = 1.0f;
+
+		outputsEvaluated_ = false;
 	}
 
+	/// <summary>
+	/// Evaluates every node that the outputs depend on, in topological order (without recursion).
+	/// </summary>
 	void Genome::evaluateOutputNodes()
 	{
 		BENCHMARK_START(Evaluate_Output_nodes);
 
-		auto limit = inputCount_ + 1ULL + outputCount_; // +1 because of the bias input node.
-		for (size_t i = inputCount_ + 1ULL; i < limit; i++)
-			nodeGenes_[i].evaluate(nodeGenes_);
+		prepareNodeValues();
+
+		const auto& plan = evaluationPlan();
+
+		size_t input = 0;
+		for (size_t i = 0; i < plan.nodes.size(); i++)
+		{
+			float value = 0;
+			for (; input < plan.inputEnds[i]; input++)
+				value += plan.inputs[input].weight * nodeValues_[plan.inputs[input].node];
+
+			nodeValues_[plan.nodes[i]] = sigmoid(value);
+		}
+
+		outputsEvaluated_ = true;
 	}
 
 	/// <summary>
@@ -471,10 +1224,10 @@ namespace neat
 		auto index = inputCount_ + 1ULL + outputIndex;
 
 		assert(outputIndex < outputCount_ && "Tried retrieving output that doesn't exist!");
-		assert(nodeGenes_[index].type_ == NodeGene::NodeType::OUTPUT && "Node is not an output node!");
-		assert(nodeGenes_[index].cached_ && "Tried retrieving output that hasn't been calculated yet!");
+		assert(topology_->nodeGenes_[index].type_ == NodeGene::NodeType::OUTPUT && "Node is not an output node!");
+		assert(outputsEvaluated_ && "Tried retrieving output that hasn't been calculated yet!");
 
-		return nodeGenes_[index].value_;
+		return nodeValues_[index];
 	}
 
 	/// <summary>
@@ -482,31 +1235,447 @@ namespace neat
 	/// </summary>
 	std::vector<float> Genome::getOutputValues()
 	{
-		std::vector<float> returnValues;
-		returnValues.reserve(outputCount_);
+		assert(outputsEvaluated_ && "Tried retrieving outputs that haven't been calculated yet!");
 
-		auto limit = inputCount_ + 1ULL + outputCount_; // +1 because of the bias input node.
-		for (size_t i = inputCount_ + 1ULL; i < limit; i++)
+		const auto outputBegin = nodeValues_.begin() + inputCount_ + 1; // +1 because of the bias input node.
+		return std::vector<float>(outputBegin, outputBegin + outputCount_);
+	}
+
+	/// <summary>
+	/// Gets the evaluation plan, building it first if anything changed since it was last built.
+	/// </summary>
+	const Genome::EvaluationPlan& Genome::evaluationPlan()
+	{
+		if (plan_.valid)
+			return plan_;
+
+		const auto& evaluationOrder = topology_->evaluationOrder_;
+		const auto& connections = topology_->connections_;
+		const auto& weights = values().weights;
+
+		plan_.nodes.assign(evaluationOrder.data(), evaluationOrder.data() + evaluationOrder.size());
+		plan_.inputEnds.clear();
+		plan_.inputEnds.reserve(evaluationOrder.size());
+		plan_.inputs.clear();
+		plan_.inputs.reserve(connections.size());
+
+		for (auto node : evaluationOrder)
 		{
-			assert(nodeGenes_[i].cached_ && "Tried retrieving output that hasn't been calculated yet!");
+			for (auto connIndex : topology_->nodeGenes_[node].incomming_)
+			{
+				// Disabled connections don't contribute to the output.
+				if (isConnectionExpressed(connIndex))
+					plan_.inputs.push_back({ connections[connIndex].inNode, weights[connIndex] });
+			}
 
-			returnValues.push_back(nodeGenes_[i].value_);
+			plan_.inputEnds.push_back(static_cast<uint32_t>(plan_.inputs.size()));
 		}
 
+		plan_.valid = true;
+		return plan_;
+	}
+
+	/// <summary>
+	/// Makes sure there is a value for every node. Copies start without any, and nodes may have been added since the last evaluation.
+	/// </summary>
+	void Genome::prepareNodeValues()
+	{
+		if (nodeValues_.size() != topology_->nodeGenes_.size())
+			nodeValues_.resize(topology_->nodeGenes_.size());
+	}
+
+	/// <summary>
+	/// Finds every output and hidden node that an output depends on, by walking the topological order backwards from the outputs.
+	/// </summary>
+	void Genome::computeEvaluationOrder(Topology& topology)
+	{
+		std::vector<bool> needed(topology.nodeGenes_.size(), false);
+		for (size_t i = 0; i < topology.nodeGenes_.size(); i++)
+			needed[i] = topology.nodeGenes_[i].type_ == NodeGene::NodeType::OUTPUT;
+
+		for (auto it = topology.topologicalOrder_.rbegin(); it != topology.topologicalOrder_.rend(); it++)
+		{
+			if (!needed[*it])
+				continue;
+
+			for (auto connIndex : topology.nodeGenes_[*it].incomming_)
+				needed[topology.connections_[connIndex].inNode] = true;
+		}
 
-		return returnValues;
+		topology.evaluationOrder_.clear();
+		for (auto node : topology.topologicalOrder_)
+		{
+			if (needed[node] && topology.nodeGenes_[node].type_ != NodeGene::NodeType::INPUT)
+				topology.evaluationOrder_.push_back(static_cast<uint32_t>(node));
+		}
 	}
 
-	void Genome::reconnectIncommingPointers()
+	void Genome::reconnectIncommingPointers(Topology& topology)
 	{
-		for (auto& nodeGene : nodeGenes_)
+		for (auto& nodeGene : topology.nodeGenes_)
+		{
 			nodeGene.incomming_.clear();
+			nodeGene.outgoing_.clear();
+		}
 
-		for (auto& [innovationNumber, connectionGene] : connectionGenes_)
+		for (size_t i = 0; i < topology.connections_.size(); i++)
 		{
-			nodeGenes_[connectionGene.outNode_].incomming_.push_back(&connectionGene);
+			topology.nodeGenes_[topology.connections_[i].outNode].incomming_.push_back(static_cast<uint32_t>(i));
+			topology.nodeGenes_[topology.connections_[i].inNode].outgoing_.push_back(static_cast<uint32_t>(i));
 		}
 	}
 
-}
+	/// <summary>
+	/// Builds the connection candidates of a topology from scratch. A hidden node can be reached from the nodes its incoming connections come from, and from every node those can be reached from, so the ancestors are collected in topological order.
+	/// </summary>
+	void Genome::buildConnectionCandidates(Topology& topology)
+	{
+		auto& candidates = topology.candidates_;
+		const auto& nodeGenes = topology.nodeGenes_;
+		const auto& connections = topology.connections_;
+
+		candidates.inputAndBiasCount = std::count_if(nodeGenes.begin(), nodeGenes.end(), [](const NodeGene& node) { return node.type_ == NodeGene::NodeType::INPUT; });
+		candidates.outputCount = std::count_if(nodeGenes.begin(), nodeGenes.end(), [](const NodeGene& node) { return node.type_ == NodeGene::NodeType::OUTPUT; });
+		const uint64_t hiddenBegin = candidates.inputAndBiasCount + candidates.outputCount;
+		const uint64_t hiddenCount = nodeGenes.size() - hiddenBegin;
+		const uint64_t sourceCount = candidates.inputAndBiasCount + hiddenCount;
+		const uint64_t targetCount = candidates.outputCount + hiddenCount;
+
+		candidates.rowWords = (targetCount + 63) / 64;
+		candidates.ancestors.assign(hiddenCount * candidates.rowWords, 0);
+		candidates.blockedTargets.assign(sourceCount * candidates.rowWords, 0);
+
+		const auto ancestorRow = [&](uint64_t node) { return candidates.ancestors.data() + (node - hiddenBegin) * candidates.rowWords; };
+		const auto targetIndex = [&](uint64_t node) { return node - candidates.inputAndBiasCount; };
+
+		for (auto node : topology.topologicalOrder_)
+		{
+			if (node < hiddenBegin)
+				continue;
+
+			uint64_t* row = ancestorRow(node);
+			for (auto connIndex : nodeGenes[node].incomming_)
+			{
+				const uint64_t previousNode = connections[connIndex].inNode;
+				if (previousNode < hiddenBegin)
+					continue;
+
+				const uint64_t* previousRow = ancestorRow(previousNode);
+				for (size_t w = 0; w < candidates.rowWords; w++)
+					row[w] |= previousRow[w];
+				row[targetIndex(previousNode) / 64] |= uint64_t{ 1 } << (targetIndex(previousNode) % 64);
+			}
+		}
+
+		std::vector<int64_t> freeTargetCounts(sourceCount);
+		for (uint64_t source = 0; source < sourceCount; source++)
+		{
+			const uint64_t node = source < candidates.inputAndBiasCount ? source : source + candidates.outputCount;
+			uint64_t* row = candidates.blockedTargets.data() + source * candidates.rowWords;
+			if (node >= hiddenBegin)
+			{
+				std::copy(ancestorRow(node), ancestorRow(node) + candidates.rowWords, row);
+				row[targetIndex(node) / 64] |= uint64_t{ 1 } << (targetIndex(node) % 64);
+			}
+			for (auto connIndex : nodeGenes[node].outgoing_)
+				row[targetIndex(connections[connIndex].outNode) / 64] |= uint64_t{ 1 } << (targetIndex(connections[connIndex].outNode) % 64);
+
+			int64_t blockedCount = 0;
+			for (size_t w = 0; w < candidates.rowWords; w++)
+				blockedCount += countSetBits(row[w]);
+			freeTargetCounts[source] = static_cast<int64_t>(targetCount) - blockedCount;
+		}
+		candidates.freeTargetCounts.assign(freeTargetCounts);
+	}
+
+	/// <summary>
+	/// Adds the last node of the topology, a new hidden node without connections, to its connection candidates. Every source can connect to it, and it can connect to every other target.
+	/// </summary>
+	void Genome::addNodeToConnectionCandidates(Topology& topology)
+	{
+		auto& candidates = topology.candidates_;
+		const uint64_t hiddenCount = topology.nodeGenes_.size() - candidates.inputAndBiasCount - candidates.outputCount;
+		const uint64_t sourceCount = candidates.inputAndBiasCount + hiddenCount;
+		const uint64_t targetCount = candidates.outputCount + hiddenCount;
+
+		// Rows only grow once the new target doesn't fit in them anymore. That moves every row, which is no more than copying the topology already costs.
+		if (targetCount > 64 * candidates.rowWords)
+		{
+			const size_t rowWords = candidates.rowWords;
+			const auto widen = [rowWords](std::vector<uint64_t>& rows)
+			{
+				const size_t rowCount = rowWords == 0 ? 0 : rows.size() / rowWords;
+				rows.resize(rowCount * (rowWords + 1), 0);
+				for (size_t row = rowCount; row-- > 0;)
+				{
+					std::copy_backward(rows.begin() + row * rowWords, rows.begin() + (row + 1) * rowWords, rows.begin() + row * (rowWords + 1) + rowWords);
+					rows[row * (rowWords + 1) + rowWords] = 0;
+				}
+			};
+			widen(candidates.ancestors);
+			widen(candidates.blockedTargets);
+			candidates.rowWords++;
+		}
+
+		candidates.ancestors.resize(hiddenCount * candidates.rowWords, 0);
+		candidates.blockedTargets.resize(sourceCount * candidates.rowWords, 0);
+		const uint64_t newTarget = targetCount - 1;
+		candidates.blockedTargets[(sourceCount - 1) * candidates.rowWords + newTarget / 64] |= uint64_t{ 1 } << (newTarget % 64);
+
+		// Every other source gets one more target, so all counts change.
+		std::vector<int64_t> freeTargetCounts(sourceCount);
+		for (uint64_t source = 0; source + 1 < sourceCount; source++)
+			freeTargetCounts[source] = candidates.freeTargetCounts.weight(source) + 1;
+		freeTargetCounts[sourceCount - 1] = static_cast<int64_t>(targetCount) - 1;
+		candidates.freeTargetCounts.assign(freeTargetCounts);
+	}
+
+	/// <summary>
+	/// Removes the connection from inNode to outNode from the candidates once it is added. If outNode is a hidden node, inNode and everything it can be reached from can now reach outNode and every node after it, 
+	/// so those nodes can't connect back to them anymore. Only the nodes that gain ancestors are visited.
+	/// </summary>
+	void Genome::addConnectionToCandidates(Topology& topology, uint64_t inNode, uint64_t outNode)
+	{
+		auto& candidates = topology.candidates_;
+		const uint64_t hiddenBegin = candidates.inputAndBiasCount + candidates.outputCount;
+		const auto sourceIndex = [&](uint64_t node) { return node < candidates.inputAndBiasCount ? node : node - candidates.outputCount; };
+		const auto targetIndex = [&](uint64_t node) { return node - candidates.inputAndBiasCount; };
+
+		uint64_t* inRow = candidates.blockedTargets.data() + sourceIndex(inNode) * candidates.rowWords;
+		assert(!(inRow[targetIndex(outNode) / 64] & (uint64_t{ 1 } << (targetIndex(outNode) % 64))) && "The connection is not a candidate!");
+		inRow[targetIndex(outNode) / 64] |= uint64_t{ 1 } << (targetIndex(outNode) % 64);
+		candidates.freeTargetCounts.add(sourceIndex(inNode), -1);
+
+		// Input nodes can't be targets, so they are never in the way of another connection.
+		if (inNode < hiddenBegin || outNode < hiddenBegin)
+			return;
+
+		thread_local std::vector<uint64_t> newAncestors;
+		thread_local std::vector<uint64_t> stack;
+		const uint64_t* inAncestors = candidates.ancestors.data() + (inNode - hiddenBegin) * candidates.rowWords;
+		newAncestors.assign(inAncestors, inAncestors + candidates.rowWords);
+		newAncestors[targetIndex(inNode) / 64] |= uint64_t{ 1 } << (targetIndex(inNode) % 64);
+
+		// A node that already had all of them as ancestors passes them on to everything after it as well, so the walk stops there.
+		stack.assign(1, outNode);
+		while (!stack.empty())
+		{
+			const uint64_t node = stack.back();
+			stack.pop_back();
+
+			uint64_t* ancestors = candidates.ancestors.data() + (node - hiddenBegin) * candidates.rowWords;
+			uint64_t* blocked = candidates.blockedTargets.data() + sourceIndex(node) * candidates.rowWords;
+			int64_t gained = 0;
+			for (size_t w = 0; w < candidates.rowWords; w++)
+			{
+				const uint64_t added = newAncestors[w] & ~ancestors[w];
+				ancestors[w] |= added;
+				blocked[w] |= added;
+				gained += countSetBits(added);
+			}
+			if (gained == 0)
+				continue;
+
+			candidates.freeTargetCounts.add(sourceIndex(node), -gained);
+			for (auto connIndex : topology.nodeGenes_[node].outgoing_)
+			{
+				const uint64_t nextNode = topology.connections_[connIndex].outNode;
+				if (nextNode >= hiddenBegin)
+					stack.push_back(nextNode);
+			}
+		}
+	}
+
+	/// <summary>
+	/// Returns the topology in use that is equal to the given one, or starts using the given one if there is none. Safe to use from multiple threads.
+	/// </summary>
+	std::shared_ptr<const Genome::Topology> Genome::internTopology(Topology&& topology)
+	{
+		topology.hash_ = topology.nodeGenes_.size();
+		for (uint64_t nodeId : topology.nodeIds_)
+			combineHash(topology.hash_, nodeId);
+
+		size_t signatureWords = Topology::minSignatureWords_c;
+		while (64 * signatureWords < 2 * topology.connections_.size())
+			signatureWords *= 2;
+		topology.signature_.assign(signatureWords, 0);
+		for (const auto& connection : topology.connections_)
+		{
+			combineHash(topology.hash_, connection.innovationNumber);
+
+			const uint64_t bit = mixHash(connection.innovationNumber) % (64 * topology.signature_.size());
+			topology.signature_[bit / 64] |= uint64_t{ 1 } << (bit % 64);
+		}
+
+		auto& table = topologyTable(topology.hash_);
+		std::lock_guard lock(table.mutex);
 
+		auto& bucket = table.topologies[topology.hash_];
+		std::weak_ptr<const Topology>* expiredEntry = nullptr;
+		for (auto& entry : bucket)
+		{
+			auto existingTopology = entry.lock();
+			if (!existingTopology)
+				expiredEntry = &entry;
+			else if (*existingTopology == topology)
+				return existingTopology;
+		}
+
+		computeEvaluationOrder(topology);
+		auto newTopology = std::make_shared<const Topology>(std::move(topology));
+
+		// A topology that keeps being dropped and created again (with the same hash) takes the place of its expired entry, so the bucket doesn't grow until the next purge.
+		if (expiredEntry)
+			*expiredEntry = newTopology;
+		else
+			bucket.push_back(newTopology);
+
+		// Forget the topologies that aren't used anymore.
+		if (table.topologies.size() >= table.purgeSize)
+		{
+			table.topologies.eraseIf([](auto& entry)
+				{
+					auto& bucket = entry.second;
+					bucket.erase(std::remove_if(bucket.begin(), bucket.end(), [](const auto& topology) { return topology.expired(); }), bucket.end());
+					return bucket.empty();
+				});
+
+			table.purgeSize = std::max<size_t>(64, table.topologies.size() * 2);
+		}
+
+		return newTopology;
+	}
+
+	/// <summary>
+	/// Places the most recently added node last in the topological order. It has no connections yet, so this is always valid.
+	/// </summary>
+	void Genome::addNodeToTopologicalOrder(Topology& topology)
+	{
+		assert(topology.nodeOrder_.size() + 1 == topology.nodeGenes_.size() && "Topological order is out of sync with the node genes!");
+
+		topology.nodeOrder_.push_back(topology.topologicalOrder_.size());
+		topology.topologicalOrder_.push_back(topology.nodeGenes_.size() - 1);
+	}
+
+	/// <summary>
+	/// Updates the topological order to account for a new connection from inNode to outNode.
+	/// </summary>
+	/// <returns>True if the order was updated (or already valid). False if the connection would create a loop, in which case the order is unchanged. </returns>
+	bool Genome::insertIntoTopologicalOrder(Topology& topology, uint64_t inNode, uint64_t outNode)
+	{
+		thread_local OrderUpdate update;
+		if (!findOrderUpdate(topology, inNode, outNode, update))
+			return false;
+
+		applyOrderUpdate(topology, update);
+		return true;
+	}
+
+	/// <summary>
+	/// Finds how the topological order has to change to account for a new connection from inNode to outNode, using the Pearce-Kelly algorithm. 
+	/// Only nodes positioned between outNode and inNode (the affected region) are visited or moved.
+	/// </summary>
+	/// <returns>True if the connection keeps the network acyclic (the update is empty if the order is already valid). False if the connection would create a loop. </returns>
+	bool Genome::findOrderUpdate(const Topology& topology, uint64_t inNode, uint64_t outNode, OrderUpdate& update)
+	{
+		update.nodes.clear();
+		update.positions.clear();
+
+		if (inNode == outNode)
+			return false;
+
+		const auto& nodeGenes = topology.nodeGenes_;
+		const auto& connections = topology.connections_;
+		const auto& nodeOrder = topology.nodeOrder_;
+
+		const uint64_t lowerBound = nodeOrder[outNode];
+		const uint64_t upperBound = nodeOrder[inNode];
+
+		// The order is already valid.
+		if (upperBound < lowerBound)
+			return true;
+
+		// Every connection that is added is checked, so each thread keeps its scratch space instead of allocating it every time.
+		// Visited flags are only needed for the affected region. They are indexed by (position - lowerBound).
+		thread_local std::vector<bool> visited;
+		thread_local std::vector<uint64_t> stack;
+		thread_local std::vector<uint64_t> forwardNodes;
+		thread_local std::vector<uint64_t> backwardNodes;
+		visited.assign(upperBound - lowerBound + 1, false);
+		stack.clear();
+		forwardNodes.clear();
+		backwardNodes.clear();
+
+		// Find every node reachable from outNode that is ordered before inNode.
+		// If inNode itself is reachable, the connection would create a loop.
+		stack.push_back(outNode);
+		visited[0] = true;
+		while (!stack.empty())
+		{
+			const uint64_t node = stack.back();
+			stack.pop_back();
+			forwardNodes.push_back(node);
+
+			for (auto connIndex : nodeGenes[node].outgoing_)
+			{
+				const uint64_t nextNode = connections[connIndex].outNode;
+				if (nextNode == inNode)
+					return false;
+
+				const uint64_t position = nodeOrder[nextNode];
+				if (position < upperBound && !visited[position - lowerBound])
+				{
+					visited[position - lowerBound] = true;
+					stack.push_back(nextNode);
+				}
+			}
+		}
+
+		// Find every node that inNode is reachable from, that is ordered after outNode.
+		stack.push_back(inNode);
+		visited[upperBound - lowerBound] = true;
+		while (!stack.empty())
+		{
+			const uint64_t node = stack.back();
+			stack.pop_back();
+			backwardNodes.push_back(node);
+
+			for (auto connIndex : nodeGenes[node].incomming_)
+			{
+				const uint64_t previousNode = connections[connIndex].inNode;
+				const uint64_t position = nodeOrder[previousNode];
+				if (position > lowerBound && !visited[position - lowerBound])
+				{
+					visited[position - lowerBound] = true;
+					stack.push_back(previousNode);
+				}
+			}
+		}
+
+		// The backward nodes are placed before the forward nodes, reusing the positions that the affected nodes already occupied.
+		const auto byPosition = [&](uint64_t node1, uint64_t node2) { return nodeOrder[node1] < nodeOrder[node2]; };
+		std::sort(forwardNodes.begin(), forwardNodes.end(), byPosition);
+		std::sort(backwardNodes.begin(), backwardNodes.end(), byPosition);
+
+		update.nodes.insert(update.nodes.end(), backwardNodes.begin(), backwardNodes.end());
+		update.nodes.insert(update.nodes.end(), forwardNodes.begin(), forwardNodes.end());
+		for (uint64_t node : update.nodes)
+			update.positions.push_back(nodeOrder[node]);
+		std::sort(update.positions.begin(), update.positions.end());
+
+		return true;
+	}
+
+	/// <summary>
+	/// Moves the nodes of an update found by findOrderUpdate, on the same topology or an unchanged copy of it.
+	/// </summary>
+	void Genome::applyOrderUpdate(Topology& topology, const OrderUpdate& update)
+	{
+		for (size_t i = 0; i < update.nodes.size(); i++)
+		{
+			topology.nodeOrder_[update.nodes[i]] = update.positions[i];
+			topology.topologicalOrder_[update.positions[i]] = update.nodes[i];
+		}
+	}
+
+}
@@ -1,24 +1,27 @@
 #ifndef NEAT_H
 #define NEAT_H
 
+#include "innovation_registry.h"
+#include "random_stream.h"
+#include "simd.h"
+#include "small_vector.h"
+#include "fenwick_tree.h"
+#include "thread_pool.h"
+
 #include <vector>
-#include <unordered_map>
+#include <array>
+#include <memory>
+#include <atomic>
+#include <utility>
 #include <cmath>
 #include <cstdint>
 
-struct hashPair
-{
-	inline size_t operator()(const std::pair<uint64_t, uint64_t>& pair) const
-	{
-		return std::hash<uint64_t>()(pair.first) ^ std::hash<uint64_t>()(pair.second);
-	}
-};
-
 namespace neat
 {
 	[[nodiscard]] inline float sigmoid(const float x, const float modifier = -4.9) { return 1.0f / (1.0f + std::exp(modifier * x)); };
 
 	class Calculator;
+	class PopulationFile;
 
 	/// <summary>
 	/// A feed-forward NEAT neural network.
@@ -43,53 +46,122 @@ namespace neat
 			// public methods
 			inline NodeType type() const { return type_; };
 
-			void evaluate(std::vector<NodeGene>& nodes);
-			[[nodiscard]] inline float getValue(std::vector<NodeGene>& nodes) { if (cached_) return value_; else evaluate(nodes); return value_; }
-
-			inline void resetCache() { cached_ = false; };
-
 		private:
 			NodeType type_;
 
-			float value_ = 0;
-			bool cached_ = false;
-
-			// Only used for evaluating the genome.
-			std::vector<ConnectionGene*> incomming_;
+			// Indices (into the topology's connections) of the connections going into this node. Only used for evaluating the genome.
+			std::vector<uint32_t> incomming_;
+			// Indices (into the topology's connections) of the connections going out of this node. Only used for maintaining the topological order.
+			std::vector<uint32_t> outgoing_;
 
 			// Friends
 			friend Genome;
 			friend Calculator;
 		};
 
+		/// <summary>
+		/// A connection gene packed into 16 bytes: 32-bit node indices, the weight, and a 31-bit innovation number with the expressed flag in its top bit.
+		/// </summary>
 		class ConnectionGene
 		{
 		public:
 			ConnectionGene();
 			ConnectionGene(uint64_t inNode, uint64_t outNode, float weight, bool expressed, uint64_t innovationNumber);
 
-			[[nodiscard]] inline bool isExpressed() const { return expressed_; };
+			[[nodiscard]] inline bool isExpressed() const { return innovationAndExpressed_ & expressedBit_c; };
 			[[nodiscard]] inline uint64_t inNode() const { return inNode_; };
 			[[nodiscard]] inline uint64_t outNode() const { return outNode_; };
 			[[nodiscard]] inline float weight() const { return weight_; };
+			[[nodiscard]] inline uint64_t innovationNumber() const { return innovationAndExpressed_ & ~expressedBit_c; };
 
-			inline void setExpressed(bool expressed) { expressed_ = expressed; };
-			inline void disable() { expressed_ = false; };
-			inline void enable() { expressed_ = true; };
+			inline void setExpressed(bool expressed) { if (expressed) enable(); else disable(); };
+			inline void disable() { innovationAndExpressed_ &= ~expressedBit_c; };
+			inline void enable() { innovationAndExpressed_ |= expressedBit_c; };
 
 			[[nodiscard]] inline bool operator==(const ConnectionGene& other) const
 			{
-				return innovationNumber_ == other.innovationNumber_;
+				return innovationNumber() == other.innovationNumber();
 			}
 
 		private:
-			static uint64_t currentInnovationNumber_s;
+			// Innovation numbers stay below InnovationRegistry::maxInnovationCount_c, so the top bit is free.
+			static constexpr uint32_t expressedBit_c = 1u << 31;
+			static_assert(InnovationRegistry::maxInnovationCount_c <= expressedBit_c, "Innovation numbers must not reach the expressed flag!");
 
-			uint64_t inNode_;
-			uint64_t outNode_;
+			uint32_t inNode_;
+			uint32_t outNode_;
 			float weight_;
-			bool expressed_;
-			uint64_t innovationNumber_;
+			uint32_t innovationAndExpressed_;
+
+			// Friends
+			friend Genome;
+		};
+
+		/// <summary>
+		/// The structure of a network: its nodes, and the endpoints and innovation numbers of its connections. 
+		/// Topologies are immutable and interned, so every genome with the same structure points at the same topology. The weights and expressed flags are stored per genome.
+		/// </summary>
+		class Topology
+		{
+		public:
+			struct Connection
+			{
+				uint32_t inNode;
+				uint32_t outNode;
+				uint32_t innovationNumber;
+			};
+
+			[[nodiscard]] inline const std::vector<NodeGene>& nodeGenes() const { return nodeGenes_; };
+			// The global id of every node. Input, bias and output nodes use their index, hidden nodes get their id from the innovation registry.
+			[[nodiscard]] inline const std::vector<uint64_t>& nodeIds() const { return nodeIds_; };
+			[[nodiscard]] inline const std::vector<Connection>& connections() const { return connections_; };
+			[[nodiscard]] inline const std::vector<uint64_t>& topologicalOrder() const { return topologicalOrder_; };
+			// The nodes that have to be evaluated to get the outputs (every output and hidden node with a path to an output), in topological order.
+			[[nodiscard]] inline const std::vector<uint32_t>& evaluationOrder() const { return evaluationOrder_; };
+			[[nodiscard]] inline uint64_t hash() const { return hash_; };
+
+			// A bit per hashed innovation number. If a bit is set in only one of two signatures, that genome has at least one gene the other doesn't.
+			// Has a power of two words, and at least twice as many bits as connections, so it doesn't fill up on large genomes. A larger signature folds onto a smaller one (see compatibilityDistanceLowerBound).
+			using Signature = std::vector<uint64_t>;
+			[[nodiscard]] inline const Signature& signature() const { return signature_; };
+
+			[[nodiscard]] bool operator==(const Topology& other) const;
+
+		private:
+			std::vector<NodeGene> nodeGenes_{};
+			// Node indices are local to a genome, so innovations are keyed on these ids instead.
+			std::vector<uint64_t> nodeIds_{};
+
+			// Sorted by innovation number. Gives O(1) random access and cheap merging with other genomes.
+			std::vector<Connection> connections_{};
+
+			// The topological order of the nodes (topologicalOrder_[position] = node) and its inverse (nodeOrder_[node] = position).
+			std::vector<uint64_t> topologicalOrder_{};
+			std::vector<uint64_t> nodeOrder_{};
+
+			// Only computed once the topology is interned.
+			std::vector<uint32_t> evaluationOrder_{};
+			uint64_t hash_ = 0;
+			Signature signature_{};
+			static constexpr size_t minSignatureWords_c = 4;
+
+			/// <summary>
+			/// The connections that can still be added without creating a loop, kept up to date as connections and nodes are added (see addConnectionMutation).
+			/// Sources are numbered [inputs + bias, hidden] and targets [outputs, hidden], like the node indices with the other kind left out.
+			/// </summary>
+			struct ConnectionCandidates
+			{
+				uint64_t inputAndBiasCount = 0;
+				uint64_t outputCount = 0;
+				size_t rowWords = 0;
+				// Per source, a bit per target it can't connect to: itself, the targets it already connects to, and the hidden nodes it can be reached from.
+				std::vector<uint64_t> blockedTargets{};
+				// Per hidden node, a bit per target it can be reached from.
+				std::vector<uint64_t> ancestors{};
+				// Per source, the number of targets it can still connect to.
+				FenwickTree<int64_t> freeTargetCounts{};
+			};
+			ConnectionCandidates candidates_{};
 
 			// Friends
 			friend Genome;
@@ -100,21 +172,46 @@ namespace neat
 		// Constructors
 		Genome();
 		Genome(size_t inputCount, size_t outputCount);
+		// Copies share the topology. Large genomes also share their weights and expressed flags, until either genome changes them, so copies are O(1).
 		Genome(const Genome& genomeToCopy);
+		Genome(Genome&& genomeToMove) noexcept = default;
+		// Crossover. The more fit parent comes first, and the child gets exactly its connections.
 		Genome(const Genome& parent1, const Genome& parent2);
 
+		Genome& operator=(const Genome& genomeToCopy);
+		Genome& operator=(Genome&& genomeToMove) noexcept = default;
+
 		// Public methods
 		Genome& mutate(float mutateWeightChance = 0.8f, float mutateAddNodeChance = 0.03f, float mutateAddConnectionChance = 0.05f);
 		Genome& addConnectionMutation();
 		Genome& addNodeMutation();
 		Genome& mutateConnectionGenes();
+		// Mutates the weights of many genomes at once, exactly like mutateConnectionGenes. Large batches are spread over the thread pool, if there is one.
+		static void mutateConnectionGenes(const std::vector<Genome*>& genomes, ThreadPool* threadPool = nullptr);
+		// Breeds one child per parent pair (the more fit parent first) into children[firstChild, firstChild + parents.size()), exactly like the crossover constructor. Large batches are spread over the thread pool, if there is one.
+		// Genomes already in those places are overwritten, which reuses their memory. children only grows if it is too small.
+		static void crossover(const std::vector<std::pair<const Genome*, const Genome*>>& parents, std::vector<Genome>& children, size_t firstChild, ThreadPool* threadPool = nullptr);
+		// Overwrites this genome with a child of the parents (the more fit parent first), exactly like the crossover constructor, but reusing this genome's memory.
+		Genome& breedFrom(const Genome& parent1, const Genome& parent2);
 
 		Genome& addHiddenNode();
+
+		// Removes connections that have been disabled for more than maxDisabledGenerations calls, and hidden nodes without a path to an output. Meant to be called once per generation.
+		Genome& collectGarbage(uint32_t maxDisabledGenerations);
 		bool addConnectionGene(uint64_t inNode, uint64_t outNode, float weight, bool expressed = true);
 
 		[[nodiscard]] float calculateCompatibilityDistance(const Genome& other, const float excessConst, const float disjointConst, const float weightDiffConst) const;
+		[[nodiscard]] float calculateCompatibilityDistance(const Genome& other, const float excessConst, const float disjointConst, const float weightDiffConst, const float cutoff) const;
+		// A lower bound of the compatibility distance from the number of genes and the topology signatures alone, much cheaper than the distance itself.
+		[[nodiscard]] float compatibilityDistanceLowerBound(const Genome& other, const float excessConst, const float disjointConst) const;
 
-		[[nodiscard]] std::pair<bool, const ConnectionGene&> hasConnection_get(const ConnectionGene& gene) const;
+		// A hash of the structure, the weights and the expressed flags. Genomes that are equal always have the same hash.
+		[[nodiscard]] uint64_t hash() const;
+		// Whether the genomes are identical: the same structure, bit-identical weights and the same expressed flags.
+		[[nodiscard]] bool operator==(const Genome& other) const;
+		[[nodiscard]] inline bool operator!=(const Genome& other) const { return !(*this == other); };
+
+		[[nodiscard]] std::pair<bool, ConnectionGene> hasConnection_get(const ConnectionGene& gene) const;
 		[[nodiscard]] bool hasConnection(const ConnectionGene& gene) const;
 
 		void resetCache();
@@ -124,32 +221,210 @@ namespace neat
 		std::vector<float> getOutputValues();
 
 		// Does not include the bias "node".
-		[[nodiscard]] inline uint64_t numberOfNodes() const { return nodeGenes_.size() - 1; };
+		[[nodiscard]] inline uint64_t numberOfNodes() const { return topology_->nodeGenes_.size() - 1; };
 		[[nodiscard]] inline uint64_t numberOfInputNodes() const { return inputCount_; };
 		[[nodiscard]] inline uint64_t numberOfOutputNodes() const { return outputCount_; };
 		[[nodiscard]] inline uint64_t numberOfHiddenNodes() const { return numberOfNodes() - numberOfInputNodes() - numberOfOutputNodes(); };
-		[[nodiscard]] inline uint64_t numberOfConnections() const { return connectionGenes_.size(); };
+		[[nodiscard]] inline uint64_t numberOfConnections() const { return values().weights.size(); };
+		[[nodiscard]] uint64_t numberOfExpressedConnections() const;
+		// The maximum number of connections this genome can have with its current nodes, without creating loops.
+		[[nodiscard]] uint64_t numberOfPossibleConnections() const;
+		// The number of connections that can be added to this genome as it is, without creating loops.
+		[[nodiscard]] inline uint64_t numberOfAddableConnections() const { return static_cast<uint64_t>(topology_->candidates_.freeTargetCounts.total()); };
+
+		// Every node index (including inputs and the bias node), ordered such that each connection goes from an earlier node to a later node.
+		[[nodiscard]] inline const std::vector<uint64_t>& topologicalOrder() const { return topology_->topologicalOrder_; };
+
+		[[nodiscard]] inline const Topology& topology() const { return *topology_; };
+		// Whether the two genomes have the same structure. Since topologies are interned, this is a pointer comparison.
+		[[nodiscard]] inline bool sharesTopologyWith(const Genome& other) const { return topology_ == other.topology_; };
+
+		// Genomes with up to this many nodes and connections keep all of their own state inline, without any heap allocations. Larger genomes move it to the heap.
+		static constexpr size_t inlineNodeCount_c = 16;
+		static constexpr size_t inlineConnectionCount_c = 32;
 
-		void reconnectIncommingPointers();
+		using Weights = SmallVector<float, inlineConnectionCount_c>;
+
+		// One weight per connection, in the same order as the topology's connections.
+		[[nodiscard]] inline const Weights& weights() const { return values().weights; };
+		[[nodiscard]] inline bool isConnectionExpressed(size_t connectionIndex) const { return (values().expressed[connectionIndex / 64] >> (connectionIndex % 64)) & 1u; };
+
+		// The registry that every genome gets its innovation numbers from. Safe to use from multiple threads.
+		[[nodiscard]] static InnovationRegistry& innovationRegistry();
 
 	private:
-		static std::unordered_map<std::pair<uint64_t, uint64_t>, uint64_t, hashPair> existingInnovations_s;
+		// Constructs a genome directly from its (already validated) serialized arrays, which are copied as they are. Used by PopulationFile.
+		Genome(uint64_t inputCount, uint64_t outputCount, uint64_t nodeCount, const Topology::Connection* connections, const float* weights, const uint64_t* expressed, size_t connectionCount, const uint64_t* topologicalOrder, const uint64_t* nodeIds);
+
+		static InnovationRegistry innovationRegistry_s;
+
+		/// <summary>
+		/// Everything needed to evaluate the genome without looking at the topology: the nodes to evaluate in order, and the (expressed) inputs of each of them.
+		/// Built when the genome is first evaluated, and thrown away by anything that changes the genome.
+		/// </summary>
+		struct EvaluationPlan
+		{
+			struct Input
+			{
+				uint32_t node;
+				float weight;
+			};
+
+			SmallVector<uint32_t, inlineNodeCount_c> nodes{};
+			// The inputs of nodes[i] end at inputs[inputEnds[i]] (and start where the inputs of the previous node end).
+			SmallVector<uint32_t, inlineNodeCount_c> inputEnds{};
+			SmallVector<Input, inlineConnectionCount_c> inputs{};
+
+			bool valid = false;
+		};
+
+		/// <summary>
+		/// The per-genome state of the connections, in the same order as the topology's connections.
+		/// </summary>
+		struct ConnectionValues
+		{
+			Weights weights{};
+			// One bit per connection, set if the connection is expressed. The bits past the last connection are always 0.
+			SmallVector<uint64_t, (inlineConnectionCount_c + 63) / 64> expressed{};
+			// Per connection, the collectGarbage call in which it was found disabled (and has been ever since), or 0 if it was expressed at the last call.
+			SmallVector<uint16_t, inlineConnectionCount_c> disabledSince{};
+		};
+
+		/// <summary>
+		/// A reference counted handle to connection values that copies of a genome share. 
+		/// Unlike a shared_ptr, it can tell whether it is the only user of the values (with acquire ordering), in which case they can be changed in place.
+		/// </summary>
+		class SharedValues
+		{
+		public:
+			SharedValues() = default;
+			explicit SharedValues(ConnectionValues&& values) : block_(new Block{ std::move(values) }) {};
+			SharedValues(const SharedValues& other) : block_(other.block_) { if (block_) block_->referenceCount.fetch_add(1, std::memory_order_relaxed); };
+			SharedValues(SharedValues&& other) noexcept : block_(other.block_) { other.block_ = nullptr; };
+			~SharedValues() { reset(); };
+
+			// Taken by value, so it works for copies and moves, and for assigning a handle to itself.
+			inline SharedValues& operator=(SharedValues other) noexcept { std::swap(block_, other.block_); return *this; };
+
+			inline void reset() 
+			{ 
+				if (block_ && block_->referenceCount.fetch_sub(1, std::memory_order_acq_rel) == 1)
+					delete block_;
+				block_ = nullptr;
+			};
+
+			[[nodiscard]] inline bool isUnique() const { return block_->referenceCount.load(std::memory_order_acquire) == 1; };
+			[[nodiscard]] inline explicit operator bool() const { return block_ != nullptr; };
+			[[nodiscard]] inline ConnectionValues& operator*() const { return block_->values; };
+			[[nodiscard]] inline ConnectionValues* operator->() const { return &block_->values; };
+			[[nodiscard]] inline bool operator==(const SharedValues& other) const { return block_ == other.block_; };
+
+		private:
+			struct Block
+			{
+				explicit Block(ConnectionValues&& values) : values(std::move(values)) {};
+
+				std::atomic<uint32_t> referenceCount = 1;
+				ConnectionValues values;
+			};
+
+			Block* block_ = nullptr;
+		};
 
-		std::vector<NodeGene> nodeGenes_{};
 		uint64_t inputCount_ = 0;
 		uint64_t outputCount_ = 0;
-		//std::vector<NodeGene*> inputNodes_{};
-		//std::vector<NodeGene*> outputNodes_{};
 
-		std::unordered_map<uint64_t, ConnectionGene> connectionGenes_{};
+		std::shared_ptr<const Topology> topology_;
+		// Small genomes keep their connection values inline. Genomes that outgrow the inline storage move them into a block that copies share
+		// until one of them changes it (copy-on-write). values_ is empty while the shared block is in use.
+		ConnectionValues values_{};
+		SharedValues sharedValues_{};
+		// The number of collectGarbage calls, counting from 1 up to UINT16_MAX and then starting over at 1.
+		uint16_t collectionCount_ = 0;
+
+		// The values of the nodes during evaluation. Kept outside of the shared topology, so each genome can be evaluated on its own.
+		SmallVector<float, inlineNodeCount_c> nodeValues_{};
+		bool outputsEvaluated_ = false;
+
+		EvaluationPlan plan_{};
+
+		// Number of matching gene weights that are gathered before being compared with SIMD.
+		static constexpr size_t weightBatchSize_c = 64;
+
+		// Weight mutation: the chance of resetting a weight (instead of perturbing it), and the ranges of new and perturbed weights.
+		static constexpr float weightResetChance_c = 0.1f;
+		static constexpr float weightResetRange_c = 12.0f;
+		static constexpr float weightPerturbRange_c = 5.0f;
+		// Batch weight mutation and crossover hand out work in pieces of at least this many weights or genes. Smaller batches stay on the calling thread.
+		static constexpr size_t minWeightsPerTask_c = 2048;
+		static constexpr size_t minGenesPerTask_c = 2048;
 
 		// Private methods
-		void addConnectionGene_assumeSafe(uint64_t inNode, uint64_t outNode, float weight, bool expressed = true);
-		void addConnectionGene_assumeSafe(const ConnectionGene& gene);
+		[[nodiscard]] static std::shared_ptr<const Topology> internTopology(Topology&& topology);
+
+		[[nodiscard]] inline const ConnectionValues& values() const { return sharedValues_ ? *sharedValues_ : values_; };
+		// The connection values, for changing them. Shared values are copied first, if another genome still uses them.
+		[[nodiscard]] ConnectionValues& mutableValues();
+		// Replaces the connection values with a copy of other's, reusing this genome's storage where possible. For genomes that are about to change them anyway.
+		void copyValuesFrom(const Genome& other);
+		void shareValuesIfLarge();
+
+		static inline void setExpressed(ConnectionValues& values, size_t connectionIndex, bool expressed)
+		{ 
+			if (expressed) 
+				values.expressed[connectionIndex / 64] |= uint64_t{ 1 } << (connectionIndex % 64);
+			else 
+				values.expressed[connectionIndex / 64] &= ~(uint64_t{ 1 } << (connectionIndex % 64));
+		};
+		inline void setConnectionExpressed(size_t connectionIndex, bool expressed) { setExpressed(mutableValues(), connectionIndex, expressed); };
+		static void insertExpressedFlag(ConnectionValues& values, size_t connectionIndex, bool expressed);
+		[[nodiscard]] ConnectionGene getConnectionGene(size_t connectionIndex) const;
+
+		inline void invalidatePlan() { plan_.valid = false; };
+		[[nodiscard]] const EvaluationPlan& evaluationPlan();
+		void prepareNodeValues();
+
+		static void computeEvaluationOrder(Topology& topology);
+
+		[[nodiscard]] static float sumAbsoluteDifferences(const float* a, const float* b, size_t count);
+		static void mutateWeights(float* weights, size_t count, RandomStream& random);
+		void inheritGenesFrom(const Genome& parent2, RandomStream& random);
+		void breedFrom(const Genome& parent1, const Genome& parent2, RandomStream& random);
+
+		/// <summary>
+		/// The nodes that a new connection moves within the topological order, and the positions they move to (nodes[i] moves to positions[i]).
+		/// </summary>
+		struct OrderUpdate
+		{
+			std::vector<uint64_t> nodes{};
+			std::vector<uint64_t> positions{};
+		};
+
+		static void addNodeToTopologicalOrder(Topology& topology);
+		// Finds the update without changing the topology, so connections can be checked against a shared topology before it is copied.
+		[[nodiscard]] static bool findOrderUpdate(const Topology& topology, uint64_t inNode, uint64_t outNode, OrderUpdate& update);
+		static void applyOrderUpdate(Topology& topology, const OrderUpdate& update);
+		[[nodiscard]] static bool insertIntoTopologicalOrder(Topology& topology, uint64_t inNode, uint64_t outNode);
+		static void reconnectIncommingPointers(Topology& topology);
+		static void buildConnectionCandidates(Topology& topology);
+		static void addNodeToConnectionCandidates(Topology& topology);
+		static void addConnectionToCandidates(Topology& topology, uint64_t inNode, uint64_t outNode);
+
+		void addConnectionGene_assumeSafe(Topology& topology, uint64_t inNode, uint64_t outNode, uint64_t innovationNumber, float weight, bool expressed = true);
+		void insertConnection(Topology& topology, const Topology::Connection& connection, float weight, bool expressed);
+
+		[[nodiscard]] inline bool isConnected(uint64_t inNode, uint64_t outNode) const { return findConnectionBetween(inNode, outNode) != numberOfConnections(); };
+		// The index of the connection from inNode to outNode, or numberOfConnections() if there is none.
+		[[nodiscard]] size_t findConnectionBetween(uint64_t inNode, uint64_t outNode) const;
+		// The index of the connection with the given innovation number, or numberOfConnections() if there is none.
+		[[nodiscard]] size_t findConnection(uint64_t innovationNumber) const;
 
 		friend Calculator;
+		friend PopulationFile;
 	};
 
+	static_assert(sizeof(Genome::ConnectionGene) == 16, "Connection genes should be packed into 16 bytes!");
+
 };
 
 #endif /* NEAT_H */
\ No newline at end of file
@@ -0,0 +1,69 @@
+#include "allocation_counter.h"
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+// Every replaceable form of operator new and delete that isn't over-aligned is replaced, so each allocation is counted once and every deallocation goes through the same free as its allocation.
+// The over-aligned forms are left to the standard library, which pairs them with each other.
+// The replacements live in their own translation unit, so the compiler never sees the malloc of one inlined next to the delete of another.
+static std::atomic<size_t> allocationCount_s = 0;
+
+size_t neat::allocationCount()
+{
+	return allocationCount_s.load();
+}
+
+void* operator new(size_t size)
+{
+	allocationCount_s++;
+	if (void* memory = std::malloc(size > 0 ? size : 1))
+		return memory;
+
+	throw std::bad_alloc();
+}
+
+void* operator new[](size_t size)
+{
+	return operator new(size);
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept
+{
+	allocationCount_s++;
+	return std::malloc(size > 0 ? size : 1);
+}
+
+void* operator new[](size_t size, const std::nothrow_t& tag) noexcept
+{
+	return operator new(size, tag);
+}
+
+void operator delete(void* memory) noexcept
+{
+	std::free(memory);
+}
+
+void operator delete[](void* memory) noexcept
+{
+	operator delete(memory);
+}
+
+void operator delete(void* memory, size_t) noexcept
+{
+	operator delete(memory);
+}
+
+void operator delete[](void* memory, size_t) noexcept
+{
+	operator delete(memory);
+}
+
+void operator delete(void* memory, const std::nothrow_t&) noexcept
+{
+	operator delete(memory);
+}
+
+void operator delete[](void* memory, const std::nothrow_t&) noexcept
+{
+	operator delete(memory);
+}
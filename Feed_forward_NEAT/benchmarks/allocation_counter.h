@@ -0,0 +1,15 @@
+#ifndef ALLOCATION_COUNTER_H
+#define ALLOCATION_COUNTER_H
+
+#include <cstddef>
+
+namespace neat
+{
+	/// <summary>
+	/// The number of heap allocations the program has made so far.
+	/// Linking allocation_counter.cpp into a program replaces the global operator new and delete with ones that count, so benchmarks and tests can check how much a piece of code allocates.
+	/// </summary>
+	[[nodiscard]] size_t allocationCount();
+}
+
+#endif /* ALLOCATION_COUNTER_H */
@@ -14,9 +14,15 @@
 #include <benchmarker.h>
 #include <NEAT.h>
 #include <calculator.h>
+#include <evaluator.h>
+#include <flat_hash_map.h>
+#include "allocation_counter.h"
 #include <random>
+#include <unordered_map>
 #include <iostream>
 #include <array>
+#include <atomic>
+#include <cmath>
 
 #ifdef _WIN32
 #include <windows.h>
@@ -26,6 +32,43 @@
 #include <sched.h>  // sched_setaffinity
 #endif
 
+namespace
+{
+	// Rewards networks for solving xor.
+	class XorEvaluator : public neat::Evaluator
+	{
+	public:
+		explicit XorEvaluator(size_t populationSize)
+			: neat::Evaluator(populationSize)
+		{
+			for (size_t i = 0; i < populationSize; i++)
+				genomes_.emplace_back(2, 1).addConnectionMutation();
+		}
+
+	protected:
+		float evaluateGenomeTraining(neat::Genome& genome) override
+		{
+			float error = 0;
+			for (size_t i = 0; i < inputs_.size(); i++)
+			{
+				genome.resetCache();
+				genome.setInputValues(inputs_[i]);
+				genome.evaluateOutputNodes();
+				error += std::abs(genome.getOutputValue(0) - expectedOutputs_[i]);
+			}
+
+			return (4 - error) * (4 - error);
+		}
+
+		FitnessCorrectpercentagePair evaluateGenomeTest(neat::Genome&) override { return { 0.0f, 0.0f }; }
+
+	private:
+		// Created once, so the evaluation itself doesn't allocate.
+		const std::array<std::vector<float>, 4> inputs_{ { { 0.0f, 0.0f }, { 0.0f, 1.0f }, { 1.0f, 0.0f }, { 1.0f, 1.0f } } };
+		const std::array<float, 4> expectedOutputs_{ 0.0f, 1.0f, 1.0f, 0.0f };
+	};
+}
+
 int main(int argc, char** argv)
 {
 #ifdef _WIN32 
@@ -206,6 +249,177 @@ int main(int argc, char** argv)
 
 		std::cout << "Large random network calculator evaluation complete." << std::endl;
 	}
+
+	// Test weight mutation speed for a population of medium sized networks.
+	{
+		const size_t populationSize = 500;
+
+		neat::Genome network{ 20, 5 };
+		while (network.numberOfConnections() < 60)
+			network.addConnectionMutation();
+		while (network.numberOfHiddenNodes() < 20)
+			network.addNodeMutation();
+		while (network.numberOfConnections() < 200)
+			network.addConnectionMutation();
+
+		std::vector<neat::Genome> population(populationSize, network);
+		std::vector<neat::Genome*> populationPointers;
+		for (auto& genome : population)
+			populationPointers.push_back(&genome);
+
+		// One genome at a time.
+		{
+			BENCHMARK_START(Population_weight_mutation);
+
+			Benchmarker::runNormalTestWriteToFile(2000, "Population_weight_mutation.csv", [&]() {
+				for (auto& genome : population)
+					genome.mutateConnectionGenes();
+				});
+		}
+
+		std::cout << "Population weight mutation complete." << std::endl;
+
+		// The whole population at once.
+		{
+			BENCHMARK_START(Population_weight_mutation_batch);
+
+			Benchmarker::runNormalTestWriteToFile(2000, "Population_weight_mutation_batch.csv", [&]() {
+				neat::Genome::mutateConnectionGenes(populationPointers);
+				});
+		}
+
+		std::cout << "Population batch weight mutation complete." << std::endl;
+	}
+
+	// Test innovation lookup speed, with the hash maps the registry used before and uses now.
+	{
+		struct xorHashPair
+		{
+			inline size_t operator()(const std::pair<uint64_t, uint64_t>& pair) const
+			{
+				return std::hash<uint64_t>()(pair.first) ^ std::hash<uint64_t>()(pair.second);
+			}
+		};
+
+		// Connections between the first few hundred nodes, like the registry sees in a typical population.
+		std::uniform_int_distribution<uint64_t> nodeRnd(0, 300);
+		std::vector<std::pair<uint64_t, uint64_t>> connections(5000);
+		for (auto& connection : connections)
+			connection = { nodeRnd(gen), nodeRnd(gen) };
+
+		std::unordered_map<std::pair<uint64_t, uint64_t>, uint64_t, xorHashPair> unorderedMap;
+		neat::FlatHashMap<std::pair<uint64_t, uint64_t>, uint64_t, hashPair> flatMap;
+		for (size_t i = 0; i < connections.size(); i++)
+		{
+			unorderedMap.emplace(connections[i], i);
+			flatMap.emplace(connections[i], i);
+		}
+
+		volatile uint64_t resultStore; // Prevents compiler from optimizing out the result.
+
+		{
+			BENCHMARK_START(Innovation_lookup_unordered_map);
+
+			Benchmarker::runNormalTestWriteToFile(5000, "Innovation_lookup_unordered_map.csv", [&]() {
+				for (const auto& connection : connections)
+					resultStore = unorderedMap.find(connection)->second;
+				});
+		}
+
+		std::cout << "Innovation lookup with std::unordered_map complete." << std::endl;
+
+		{
+			BENCHMARK_START(Innovation_lookup_flat_hash_map);
+
+			Benchmarker::runNormalTestWriteToFile(5000, "Innovation_lookup_flat_hash_map.csv", [&]() {
+				for (const auto& connection : connections)
+					resultStore = flatMap.find(connection)->second;
+				});
+		}
+
+		std::cout << "Innovation lookup with neat::FlatHashMap complete." << std::endl;
+
+		// Through the registry, which also locks a shard per lookup.
+		{
+			neat::InnovationRegistry registry;
+			for (const auto& connection : connections)
+				resultStore = registry.getInnovationNumber(connection.first, connection.second);
+
+			BENCHMARK_START(Innovation_lookup_registry);
+
+			Benchmarker::runNormalTestWriteToFile(5000, "Innovation_lookup_registry.csv", [&]() {
+				for (const auto& connection : connections)
+					resultStore = registry.getInnovationNumber(connection.first, connection.second);
+				});
+		}
+
+		std::cout << "Innovation lookup through the registry complete." << std::endl;
+	}
+
+	// Test crossover speed for medium sized networks that share most of their genes.
+	{
+		neat::Genome parent1{ 20, 5 };
+		while (parent1.numberOfConnections() < 60)
+			parent1.addConnectionMutation();
+		while (parent1.numberOfHiddenNodes() < 20)
+			parent1.addNodeMutation();
+
+		neat::Genome parent2{ parent1 };
+		while (parent1.numberOfConnections() < 200)
+			parent1.addConnectionMutation();
+		while (parent2.numberOfConnections() < 200)
+			parent2.addConnectionMutation();
+
+		volatile size_t resultStore; // Prevents compiler from optimizing out the result.
+
+		{
+			BENCHMARK_START(Crossover);
+
+			Benchmarker::runNormalTestWriteToFile(20000, "Crossover.csv", [&]() {
+				neat::Genome child{ parent1, parent2 };
+				resultStore = child.numberOfConnections();
+				});
+		}
+
+		std::cout << "Crossover complete." << std::endl;
+
+		// A generation's worth of children at once.
+		{
+			std::vector<std::pair<const neat::Genome*, const neat::Genome*>> parents(500, { &parent1, &parent2 });
+			std::vector<neat::Genome> children;
+
+			BENCHMARK_START(Crossover_batch);
+
+			// The children of the previous run are overwritten, like the generations of an evaluator.
+			Benchmarker::runNormalTestWriteToFile(200, "Crossover_batch.csv", [&]() {
+				neat::Genome::crossover(parents, children, 0);
+				resultStore = children.size();
+				});
+		}
+
+		std::cout << "Batch crossover complete." << std::endl;
+	}
+
+	// Test the speed of whole generations, and how many allocations they make once the population has settled.
+	{
+		XorEvaluator evaluator{ 150 };
+		for (size_t i = 0; i < 20; i++)
+			evaluator.evaluate_training();
+
+		const size_t generationCount = 50;
+		const size_t allocationsBefore = neat::allocationCount();
+		for (size_t i = 0; i < generationCount; i++)
+			evaluator.evaluate_training();
+		const size_t allocations = neat::allocationCount() - allocationsBefore;
+
+		BENCHMARK_START(Evolution_generation);
+
+		Benchmarker::runNormalTestWriteToFile(50, "Evolution_generation.csv", [&]() {
+			evaluator.evaluate_training();
+			});
+
+		std::cout << "Evolution complete. Allocations per generation: " << static_cast<double>(allocations) / generationCount << std::endl;
+	}
 	
 	Benchmarker::printStats();
 
@@ -1,11 +1,12 @@
 #include "calculator.h"
 
 #include <numeric>
+#include <cassert>
 #include <benchmarker.h>
 
 
 neat::Calculator::Calculator(const Genome& genome) : 
-	inputCount_c(genome.inputCount_), outputCount_c(genome.outputCount_), hiddenCount_c(genome.numberOfHiddenNodes()), connectionCount_c(genome.connectionGenes_.size()),
+	inputCount_c(genome.inputCount_), outputCount_c(genome.outputCount_), hiddenCount_c(genome.numberOfHiddenNodes()), connectionCount_c(genome.numberOfConnections()),
 	nodeCalculationOrderList_c(getNodeCalculationOrder(genome)),
 	nodeCalculationOrderList_individualOutputs_c(getOutnodeFilteredCalculationOrderLists(genome, nodeCalculationOrderList_c)),
 	nodeInputs_c(getNodeInputs(genome)),
@@ -61,33 +62,6 @@ float neat::Calculator::calculateIndex(size_t outputIndex, const std::vector<flo
 	return values[outputBegin + outputIndex];
 }
 
-std::vector<size_t> neat::Calculator::getExclusivelyDependentNodes(const Genome& genome, const std::vector<size_t>& dependencies)
-{
-	std::vector<size_t> retVec;
-
-	for (const auto& node : genome.nodeGenes_)
-	{
-		if (node.type_ == Genome::NodeGene::NodeType::INPUT)
-			continue;
-		
-		const size_t nodeIndex = node.incomming_[0]->outNode();
-		
-		[&]()
-		{
-			for (const auto& connection : node.incomming_)
-			{
-				const bool found = std::find(dependencies.begin(), dependencies.end(), connection->inNode()) != dependencies.end();
-				if (!found)
-					return; // Do not add this node
-			}
-
-			retVec.push_back(nodeIndex);
-		}();
-	}
-
-	return retVec;
-}
-
 std::vector<size_t> neat::Calculator::getNodeCalculationOrder(const Genome& genome)
 {
 	std::vector<size_t> retVec;
@@ -95,29 +69,15 @@ std::vector<size_t> neat::Calculator::getNodeCalculationOrder(const Genome& geno
 	const size_t finalReturnSize = genome.numberOfNodes() - genome.inputCount_;
 	retVec.reserve(finalReturnSize);
 	
-	// Get the initial input nodes
-	std::vector<size_t> dependencies;
-	dependencies.resize(genome.inputCount_ + 1);
-	std::iota(dependencies.begin(), dependencies.end(), 0);
-
-	// Add nodes to the return vector, until all nodes are added.
-	while (retVec.size() < finalReturnSize)
+	// The genome already maintains a topological order, so it only has to be filtered (inputs and the bias node are not calculated).
+	for (auto nodeIndex : genome.topologicalOrder())
 	{
-		auto newDependencies = getExclusivelyDependentNodes(genome, dependencies);
-		newDependencies.erase(
-			std::remove_if(
-				newDependencies.begin(), newDependencies.end(), 
-				[&](const size_t& nodeIndex)
-				{
-					return std::find(retVec.begin(), retVec.end(), nodeIndex) != retVec.end();
-				}),
-				newDependencies.end()
-		);
-
-		dependencies.insert(dependencies.end(), newDependencies.begin(), newDependencies.end());
-		retVec.insert(retVec.end(), newDependencies.begin(), newDependencies.end());
+		if (genome.topology().nodeGenes()[nodeIndex].type_ != Genome::NodeGene::NodeType::INPUT)
+			retVec.push_back(nodeIndex);
 	}
 
+	assert(retVec.size() == finalReturnSize && "Topological order does not contain every node!");
+
 	return retVec;
 }
 
@@ -159,10 +119,11 @@ std::unordered_set<size_t> neat::Calculator::getAllParentNodes(const Genome& gen
 	std::unordered_set<size_t> retSet;
 
 	std::unordered_set<size_t> notChecked;
-	for (const auto& connection : genome.nodeGenes_[nodeIndex].incomming_)
+	for (auto connIndex : genome.topology().nodeGenes()[nodeIndex].incomming_)
 	{
-		notChecked.insert(connection->inNode());
-		retSet.insert(connection->inNode());
+		const auto& connection = genome.topology().connections()[connIndex];
+		notChecked.insert(connection.inNode);
+		retSet.insert(connection.inNode);
 	}
 
 	while (notChecked.size())
@@ -171,10 +132,11 @@ std::unordered_set<size_t> neat::Calculator::getAllParentNodes(const Genome& gen
 
 		for (auto index : notChecked)
 		{
-			for (const auto& connection : genome.nodeGenes_[index].incomming_)
+			for (auto connIndex : genome.topology().nodeGenes()[index].incomming_)
 			{
-				newNotChecked.insert(connection->inNode());
-				retSet.insert(connection->inNode());
+				const auto& connection = genome.topology().connections()[connIndex];
+				newNotChecked.insert(connection.inNode);
+				retSet.insert(connection.inNode);
 			}
 		}
 
@@ -191,10 +153,14 @@ std::vector<std::vector<std::pair<size_t, float>>> neat::Calculator::getNodeInpu
 
 	for (size_t i = genome.numberOfInputNodes() + 1; i < genome.numberOfNodes() + 1; i++)
 	{
-		retVec.reserve(genome.nodeGenes_[i].incomming_.size());
-		for (auto connection : genome.nodeGenes_[i].incomming_)
+		retVec.reserve(genome.topology().nodeGenes()[i].incomming_.size());
+		for (auto connIndex : genome.topology().nodeGenes()[i].incomming_)
 		{
-			retVec[i].push_back({ connection->inNode(), connection->weight() });
+			// Disabled connections don't contribute to the output (same as Genome::evaluationPlan).
+			if (!genome.isConnectionExpressed(connIndex))
+				continue;
+
+			retVec[i].push_back({ genome.topology().connections()[connIndex].inNode, genome.weights()[connIndex] });
 		}
 	}
 
@@ -39,13 +39,9 @@ namespace neat
 		// Only used for calculating the output. It's not part of the calculator itself (therefore mutable), but constructing the vector is very expensive, so it's much faster to only do it once, at object creation.
 		mutable std::vector<float> values;
 
-		/// <summary>
-		/// Generates a list of all nodes that solely depend on the dependencies (as direct input).
-		/// </summary>
-		[[nodiscard]] static std::vector<size_t> getExclusivelyDependentNodes(const Genome& genome, const std::vector<size_t>& dependencies);
-
 		/// <summary>
 		/// Generates the nodeCalculationOrderList (The order that nodes should be calculated in (input to output) to calculate all outputs (inputs are not included).)
+		/// This is taken directly from the genome's topological order.
 		/// </summary>
 		[[nodiscard]] static std::vector<size_t> getNodeCalculationOrder(const Genome& genome);
 
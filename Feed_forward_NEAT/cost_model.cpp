@@ -0,0 +1,89 @@
+#include "cost_model.h"
+#include "NEAT.h"
+
+#include <algorithm>
+#include <cmath>
+
+
+namespace neat
+{
+
+	double EvaluationCostModel::predict(size_t connectionCount, size_t nodeCount) const
+	{
+		// Measurement noise can make a coefficient negative, but a genome never costs less than nothing.
+		return std::max(0.0, coefficients_[0] + coefficients_[1] * connectionCount + coefficients_[2] * nodeCount);
+	}
+
+	double EvaluationCostModel::predict(const Genome& genome) const
+	{
+		return predict(genome.numberOfExpressedConnections(), genome.topology().evaluationOrder().size());
+	}
+
+	void EvaluationCostModel::addMeasurement(size_t connectionCount, size_t nodeCount, double seconds)
+	{
+		const std::array<double, 3> features{ 1.0, static_cast<double>(connectionCount), static_cast<double>(nodeCount) };
+		for (size_t i = 0; i < 3; i++)
+		{
+			for (size_t j = 0; j < 3; j++)
+				featureProducts_[i][j] += features[i] * features[j];
+			featureSeconds_[i] += features[i] * seconds;
+		}
+	}
+
+	void EvaluationCostModel::addMeasurement(const Genome& genome, double seconds)
+	{
+		addMeasurement(genome.numberOfExpressedConnections(), genome.topology().evaluationOrder().size(), seconds);
+	}
+
+	/// <summary>
+	/// Solves the normal equations with Gaussian elimination. If the measurements don't determine all coefficients (e.g. every genome had the same size, or connections and nodes always grew together), the previous coefficients are kept.
+	/// </summary>
+	void EvaluationCostModel::update()
+	{
+		auto a = featureProducts_;
+		auto b = featureSeconds_;
+
+		// The matrix is symmetric positive semi-definite, so it needs no pivoting. Eliminating a column leaves, on the diagonal, the part of that feature that the earlier features don't explain.
+		// If (almost) nothing is left, the feature is a combination of the earlier ones, and its coefficient isn't determined by the measurements.
+		bool solvable = a[0][0] >= 3.0; // At least three measurements.
+		for (size_t column = 0; column < 3 && solvable; column++)
+		{
+			if (a[column][column] <= featureProducts_[column][column] * minRemainingVariance_c)
+			{
+				solvable = false;
+				break;
+			}
+
+			for (size_t row = column + 1; row < 3; row++)
+			{
+				const double factor = a[row][column] / a[column][column];
+				for (size_t k = column; k < 3; k++)
+					a[row][k] -= factor * a[column][k];
+				b[row] -= factor * b[column];
+			}
+		}
+
+		if (solvable)
+		{
+			std::array<double, 3> solution{};
+			for (size_t i = 3; i-- > 0;)
+			{
+				double value = b[i];
+				for (size_t k = i + 1; k < 3; k++)
+					value -= a[i][k] * solution[k];
+				solution[i] = value / a[i][i];
+			}
+
+			coefficients_ = solution;
+		}
+
+		for (auto& row : featureProducts_)
+		{
+			for (auto& value : row)
+				value *= decay_c;
+		}
+		for (auto& value : featureSeconds_)
+			value *= decay_c;
+	}
+
+}
@@ -0,0 +1,53 @@
+#ifndef COST_MODEL_H
+#define COST_MODEL_H
+
+#include <array>
+#include <cstdint>
+#include <cstddef>
+
+namespace neat
+{
+	class Genome;
+
+	/// <summary>
+	/// Predicts how long evaluating a genome takes, as overhead + a * expressed connections + b * evaluated nodes.
+	/// The coefficients are fitted (least squares) to measured evaluation times, with older measurements fading out, so the model follows changes in the population and the machine.
+	/// Before the first measurements, every connection and node is assumed to cost the same, which is enough to order genomes by cost.
+	/// </summary>
+	class EvaluationCostModel
+	{
+	public:
+		EvaluationCostModel() = default;
+
+		// Public methods
+		[[nodiscard]] double predict(size_t connectionCount, size_t nodeCount) const;
+		[[nodiscard]] double predict(const Genome& genome) const;
+
+		void addMeasurement(size_t connectionCount, size_t nodeCount, double seconds);
+		void addMeasurement(const Genome& genome, double seconds);
+
+		/// <summary>
+		/// Refits the coefficients to the measurements, and then fades the measurements. Meant to be called once per generation.
+		/// </summary>
+		void update();
+
+		// Getters
+		[[nodiscard]] inline const std::array<double, 3>& coefficients() const { return coefficients_; };
+
+	private:
+		// How much of the measurements is kept after each update.
+		static constexpr double decay_c = 0.5;
+		// The smallest fraction of a feature's sum of squares that the other features may leave unexplained, for its coefficient to count as determined.
+		static constexpr double minRemainingVariance_c = 1e-6;
+
+		// Decayed sums of x * x^T and x * seconds, for the features x = (1, connections, nodes).
+		std::array<std::array<double, 3>, 3> featureProducts_{};
+		std::array<double, 3> featureSeconds_{};
+
+		// Overhead, cost per connection and cost per node.
+		std::array<double, 3> coefficients_{ 0.0, 1.0, 1.0 };
+	};
+
+}
+
+#endif /* COST_MODEL_H */
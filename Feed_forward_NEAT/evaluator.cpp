@@ -5,6 +5,11 @@
 #include <algorithm>
 
 #include <iostream>
+#include <chrono>
+#include <numeric>
+#include <limits>
+#include <cmath>
+#include <mutex>
 
 
 namespace neat
@@ -15,8 +20,12 @@ namespace neat
 		const float compatibilityDistanceCutoff,
 		const float excessConst,
 		const float disjointConst,
-		const float weightDiffConst)
-		: compatibilityDistanceCutoff_(compatibilityDistanceCutoff), excessConst_(excessConst), disjointConst_(disjointConst), weightDiffConst_(weightDiffConst)
+		const float weightDiffConst,
+		const size_t fitnessCacheCapacity,
+		const size_t threadCount)
+		: compatibilityDistanceCutoff_(compatibilityDistanceCutoff), excessConst_(excessConst), disjointConst_(disjointConst), weightDiffConst_(weightDiffConst),
+		connectionCountBandActive_(std::min(excessConst, disjointConst) > 0 && compatibilityDistanceCutoff < std::min(excessConst, disjointConst)),
+		fitnessCache_(fitnessCacheCapacity), threadPool_(threadCount)
 	{
 		genomes_.reserve(populationSize);
 	}
@@ -29,160 +38,306 @@ namespace neat
 		std::random_device rd;
 		std::mt19937 gen(rd());
 
-		// Place genomes into species
-		speciesMap_.clear();
-		for (auto& g : genomes_)
+		// Place genomes into species.
+		speciate();
+
+		std::cout << species_.size() << '\n';
+
+		// Decide where the best genomes of each species go in the next generation, and how many offspring each species breeds.
+		planSurvivors(gen);
+
+		// Evaluate genomes and assign fitness. Every species whose members are all evaluated puts its best genomes into the next generation and breeds its offspring right away, while other species are still being evaluated.
+		evaluateGenomes(true);
+		computeAdjustedFitnessSums();
+
+		// The offspring of two species are only bred now, since they pick their species by the adjusted fitness of every species. The offspring are bred all at once, and mutated once they have all been bred.
+		const size_t firstCrossSpeciesOffspring = offspringOffsets_.back();
+		if (firstCrossSpeciesOffspring < genomes_.size())
 		{
-			bool placed = false;
-			for (auto& s : species_)
-			{
-				if (s.mascot.calculateCompatibilityDistance(g, excessConst_, disjointConst_, weightDiffConst_) < compatibilityDistanceCutoff_)
-				{
-					s.memberGenomes.push_back(&g);
-					speciesMap_[&g] = &s;
-					placed = true;
-					break;
-				}
-			}
-			if (!placed)
+			buildSpeciesSelectionTable([this](size_t s) { return species_[s].adjustedFitnessSum; }, [this](size_t s) { return parentOffsets_[s + 1] > parentOffsets_[s]; });
+
+			parentPairs_.clear();
+			for (size_t child = firstCrossSpeciesOffspring; child < genomes_.size(); child++)
 			{
-				// Create a new species and put it in the species vector, 
-				// while also adding the genome and species to the species map.
-				speciesMap_[&g] = &species_.emplace_back(&g);
+				// Get two random species
+				auto s1 = getRandomSpeciesBiasedAdjustedFitness(gen);
+				auto s2 = getRandomSpeciesBiasedAdjustedFitness(gen);
+
+				// Select a random genome from each
+				auto g1 = parentIndices_[std::uniform_int_distribution<size_t>(parentOffsets_[s1], parentOffsets_[s1 + 1] - 1)(gen)];
+				auto g2 = parentIndices_[std::uniform_int_distribution<size_t>(parentOffsets_[s2], parentOffsets_[s2 + 1] - 1)(gen)];
+
+				// The more fit parent should always be the first parameter.
+				if (!(parentFitnesses_[g1] > parentFitnesses_[g2]))
+					std::swap(g1, g2);
+				parentPairs_.emplace_back(g1, g2);
+				nextPredictedFitnesses_[child] = parentFitnesses_[g1];
 			}
+
+			// The parents come before the offspring in nextGenomes_, which already has room for all of them, so breeding doesn't move them.
+			parents_.clear();
+			for (auto [g1, g2] : parentPairs_)
+				parents_.emplace_back(&nextGenomes_[g1], &nextGenomes_[g2]);
+			Genome::crossover(parents_, nextGenomes_, firstCrossSpeciesOffspring, &threadPool_);
+			mutateGenomes(nextGenomes_, firstCrossSpeciesOffspring, genomes_.size());
 		}
 
-		// Check if every species has members, remove any that don't.
-		for (size_t i = 0; i < species_.size(); i++)
+		// Reset all species, with a random member as the new mascot.
+		for (auto& species : species_)
 		{
-			if (species_[i].memberGenomes.size() == 0)
-			{
-				species_.erase(species_.begin() + i);
-				i--;
-			}
+			std::uniform_int_distribution<size_t> dis(species.memberBegin, species.memberEnd - 1);
+			species.reset(genomes_[speciesMembers_[dis(gen)]]);
 		}
 
-		std::cout << species_.size() << '\n';
+		// The old generation becomes the buffer the generation after this one is built in.
+		genomes_.swap(nextGenomes_);
+		predictedFitnesses_.swap(nextPredictedFitnesses_);
+		fitnessesCurrent_ = false;
 
-		// Evaluate genomes and assign fitness
-		calculateFitnessMap();
+		// Remove genes that don't contribute anything anymore, so genomes don't keep growing.
+		threadPool_.parallelFor(genomes_.size(), [this](size_t i) { genomes_[i].collectGarbage(maxDisabledGenerations_c); });
 
-		// Put the best genomes from each species (with 5 or more Genomes) into the next generation
-		std::vector<Genome> nextGenGenomes;
-		nextGenGenomes.reserve(genomes_.size());
-		// Also, keep a pointer map to each new genome. This will be used for breeding the next generation.
-		std::unordered_map<const Species*, std::vector<Genome*>> newGenomeSpeciesMap;
+		// Structural mutations in the next generation should only share innovation numbers with each other.
+		Genome::innovationRegistry().nextGeneration();
+	}
 
-		for (auto& s : species_)
-		{
-			// Sort the species genomes by fitness
-			std::sort(s.memberGenomes.begin(), s.memberGenomes.end(), [&](Genome* g1, Genome* g2)
-				{
-					return fitnessMap_[g1] > fitnessMap_[g2];
-				});
+	//void Evaluator::evaluate_training()
+	//{
+	//	
+	//}
 
-			if (s.memberGenomes.size() > 4)
-			{
-				// todo: Maybe move here?
-				auto& newGenome = nextGenGenomes.emplace_back(*s.memberGenomes[0]);
-				newGenomeSpeciesMap[&s].push_back(&newGenome);
-			}
-		}
+	void Evaluator::evaluate_testing()
+	{
+	}
 
-		// Put the 50% best of each species into the next generation and mutate them.
-		for (auto& s : species_)
+	/// <summary>
+	/// Evolves the population without generations: every thread of the pool repeatedly replaces the worst genome with offspring (see removeWorstGenome), and breeds and evaluates it, until replacementCount genomes have been replaced.
+	/// Only picking the genomes and placing the offspring into a species is done under a lock, so no thread waits for the slowest evaluation of a generation. Genomes are never split into chunks of training samples.
+	/// </summary>
+	void Evaluator::evaluate_steadyState(size_t replacementCount)
+	{
+		assert(genomes_.size() > 2 && "Steady-state evolution needs at least three genomes!");
+
+		// Start from a speciated and evaluated population. An earlier call leaves it that way, otherwise genomes that were evaluated before come from the fitness cache.
+		if (!fitnessesCurrent_)
 		{
-			// They should already be sorted here.
-			for (size_t i = 1; i < s.memberGenomes.size() / 2; i++)
-			{
-				auto& newGenome = nextGenGenomes.emplace_back(*s.memberGenomes[i]).mutate();
-				newGenomeSpeciesMap[&s].push_back(&newGenome);
-			}
+			speciate();
+			calculateFitnesses();
 		}
 
-		// Breed the remaining genomes.
-		std::uniform_real_distribution<float> dis0_1(0.0f, 1.0f);
-		while (nextGenGenomes.size() < genomes_.size())
+		beingEvaluated_.assign(genomes_.size(), 0);
+		steadyStateSpecies_.clear();
+		steadyStateSpecies_.resize(species_.size());
+		availablePositions_.resize(genomes_.size());
+		for (size_t g = 0; g < genomes_.size(); g++)
 		{
-			// 0.1% chance to cross-breed between species.
-			if (dis0_1(gen) < 0.001f)
-			{
-				// Get two random species
-				auto s1 = getRandomSpeciesBiasedAdjustedFitness();
-				auto s2 = getRandomSpeciesBiasedAdjustedFitness();
+			steadyStateSpecies_[speciesIds_[g]].memberCount++;
+			makeAvailable(g);
+		}
+		rankSteadyStateSpecies();
 
-				// Select a random genome from each
-				//auto g1 = s1->memberGenomes[std::uniform_int_distribution<size_t>(0, s1->memberGenomes.size() - 1)(gen)];
-				//auto g2 = s2->memberGenomes[std::uniform_int_distribution<size_t>(0, s2->memberGenomes.size() - 1)(gen)];
-				auto& g1VectorRef = newGenomeSpeciesMap[s1];
-				auto g1 = g1VectorRef[std::uniform_int_distribution<size_t>(0, g1VectorRef.size() - 1)(gen)];
-				auto& g2VectorRef = newGenomeSpeciesMap[s2];
-				auto g2 = g2VectorRef[std::uniform_int_distribution<size_t>(0, g2VectorRef.size() - 1)(gen)];
-
-				// Crossover
-				if (fitnessMap_[g1] > fitnessMap_[g2])
-					nextGenGenomes.emplace_back(*g1, *g2).mutate();
-				else
-					nextGenGenomes.emplace_back(*g2, *g1).mutate();
-			}
-			//else if (dis0_1(gen) < 0.25f) 
-			//{
-			//	// Get a random species and take a genome from the top 25% (excluding the best if there are more than 4), then mutate it and add it to the next generation.
-			//	std::uniform_int_distribution<size_t> dis;
-			//	auto randomSpecies = getRandomSpeciesBiasedAdjustedFitness();
-			//	
-			//	if (randomSpecies->memberGenomes.size() > 4)
-			//		dis = std::uniform_int_distribution<size_t>(1, static_cast<size_t>(1 + randomSpecies->memberGenomes.size() * 0.25f));
-			//	else
-			//		dis = std::uniform_int_distribution<size_t>(0, static_cast<size_t>((randomSpecies->memberGenomes.size() - 1) * 0.25f));
-			//	
-			//	nextGenGenomes.emplace_back(*randomSpecies->memberGenomes[dis(gen)]).mutate();
-			//}
-			else
+		// Create random devices
+		std::random_device rd;
+		std::mt19937 gen(rd());
+
+		std::mutex mutex;
+		size_t replacementsStarted = 0;
+
+		// Every thread takes one genome out of the population while breeding and evaluating it, and at least two others have to be left to replace and to breed from.
+		const size_t workerCount = std::min(threadPool_.threadCount(), genomes_.size() - 2);
+		threadPool_.parallelFor(workerCount, [&](size_t)
 			{
-				// Breed two genomes from the same species and mutate the offspring.
-				auto s = getRandomSpeciesBiasedAdjustedFitness();
+				// The parents are copied, since other threads may replace them while the offspring is bred.
+				Genome parent1, parent2;
+				const std::vector<std::pair<const Genome*, const Genome*>> parents{ { &parent1, &parent2 } };
 
-				auto memberVecRef = &newGenomeSpeciesMap[s];
-				std::uniform_int_distribution<size_t> dis(0, memberVecRef->size() - 1);
-				auto g1 = (*memberVecRef)[dis(gen)];
-				auto g2 = (*memberVecRef)[dis(gen)];
+				std::unique_lock<std::mutex> lock(mutex);
+				while (replacementsStarted < replacementCount)
+				{
+					replacementsStarted++;
+					const size_t genomeIndex = removeWorstGenome(gen, parent1, parent2);
+
+					// Nothing else touches the genome until it is placed into a species, so it is bred without the lock.
+					lock.unlock();
+					Genome::crossover(parents, genomes_, genomeIndex);
+					genomes_[genomeIndex].mutate(mutateWeightChance_, mutateAddNodeChance_, mutateAddConnectionChance_);
+					genomes_[genomeIndex].collectGarbage(maxDisabledGenerations_c);
+					lock.lock();
+
+					speciesIds_[genomeIndex] = placeInSpecies(genomes_[genomeIndex]);
+					steadyStateSpecies_[speciesIds_[genomeIndex]].memberCount++;
+					rankSteadyStateSpecies(speciesIds_[genomeIndex]);
+
+					if (auto cachedFitness = fitnessCache_.find(genomes_[genomeIndex]))
+					{
+						fitnesses_[genomeIndex] = *cachedFitness;
+					}
+					else
+					{
+						lock.unlock();
+						const float fitness = evaluateGenomeTraining(genomes_[genomeIndex]);
+						lock.lock();
+
+						fitnesses_[genomeIndex] = fitness;
+						fitnessCache_.insert(genomes_[genomeIndex], fitness);
+					}
+
+					beingEvaluated_[genomeIndex] = 0;
+					makeAvailable(genomeIndex);
+					rankSteadyStateSpecies(speciesIds_[genomeIndex]);
+				}
+			});
 
-				//std::uniform_int_distribution<size_t> dis(0, s->memberGenomes.size() - 1);
-				//auto g1 = s->memberGenomes[dis(gen)];
-				//auto g2 = s->memberGenomes[dis(gen)];
+		// Leave the species the way evaluate_training expects them. Species that lost all their members are only removed here.
+		groupSpeciesMembers();
+		for (auto& species : species_)
+			species.adjustedFitnessSum = 0;
+		fitnessesCurrent_ = true;
+	}
 
-				// The more fit parent should always be the first parameter.
-				if (fitnessMap_[g1] > fitnessMap_[g2])
-					nextGenGenomes.emplace_back(*g1, *g2).mutate();
-				else
-					nextGenGenomes.emplace_back(*g2, *g1).mutate();
+	/// <summary>
+	/// Takes the genome with the lowest adjusted fitness out of the population, and copies two genomes of a species (picked by adjusted fitness) into parent1 and parent2 to breed its replacement from, the more fit one first.
+	/// Genomes that are being evaluated take no part. Every populationSize replacements count as a generation, after which the mascots are picked again and the innovation registry moves on.
+	/// </summary>
+	/// <returns>The index of the genome, which is marked as being evaluated. </returns>
+	size_t Evaluator::removeWorstGenome(std::mt19937& gen, Genome& parent1, Genome& parent2)
+	{
+		// The least fit available member of the species ranked first has the lowest adjusted fitness of all.
+		assert(!speciesByWorstAdjustedFitness_.empty() && "Every genome is being evaluated!");
+		const size_t worstSpecies = speciesByWorstAdjustedFitness_.begin()->second;
+
+		// The worst genome leaves the population before the parents are picked, so it can't be one of them.
+		const size_t worst = steadyStateSpecies_[worstSpecies].byFitness.begin()->second;
+		makeUnavailable(worst);
+		steadyStateSpecies_[worstSpecies].memberCount--;
+		rankSteadyStateSpecies(worstSpecies);
+		beingEvaluated_[worst] = 1;
+
+		const auto& available = steadyStateSpecies_[getRandomSteadyStateSpecies(gen)].available;
+		std::uniform_int_distribution<size_t> dis(0, available.size() - 1);
+		auto g1 = available[dis(gen)];
+		auto g2 = available[dis(gen)];
+
+		// The more fit parent should always be the first parameter.
+		if (fitnesses_[g2] > fitnesses_[g1])
+			std::swap(g1, g2);
+		parent1 = genomes_[g1];
+		parent2 = genomes_[g2];
+
+		if (++steadyStateReplacements_ % genomes_.size() == 0)
+		{
+			for (size_t s = 0; s < species_.size(); s++)
+			{
+				const auto& members = steadyStateSpecies_[s].available;
+				if (!members.empty())
+					species_[s].mascot = genomes_[members[std::uniform_int_distribution<size_t>(0, members.size() - 1)(gen)]];
 			}
+			indexSpecies();
+
+			// The selection weights are summed up again, so rounding errors from adding and subtracting them don't build up.
+			rankSteadyStateSpecies();
+
+			Genome::innovationRegistry().nextGeneration();
 		}
 
-		// Reset all species
-		for (auto& species : species_)
+		return worst;
+	}
+
+	void Evaluator::makeAvailable(size_t genomeIndex)
+	{
+		auto& species = steadyStateSpecies_[speciesIds_[genomeIndex]];
+		species.byFitness.emplace(fitnesses_[genomeIndex], genomeIndex);
+		availablePositions_[genomeIndex] = species.available.size();
+		species.available.push_back(genomeIndex);
+		species.fitnessSum += fitnesses_[genomeIndex];
+	}
+
+	void Evaluator::makeUnavailable(size_t genomeIndex)
+	{
+		auto& species = steadyStateSpecies_[speciesIds_[genomeIndex]];
+		species.byFitness.erase({ fitnesses_[genomeIndex], genomeIndex });
+
+		// The last member takes its place.
+		const size_t last = species.available.back();
+		species.available[availablePositions_[genomeIndex]] = last;
+		availablePositions_[last] = availablePositions_[genomeIndex];
+		species.available.pop_back();
+
+		// Without members, rounding errors in the sum are dropped.
+		species.fitnessSum = species.available.empty() ? 0.0 : species.fitnessSum - fitnesses_[genomeIndex];
+	}
+
+	/// <summary>
+	/// Ranks every species again from scratch, in O(S log S).
+	/// </summary>
+	void Evaluator::rankSteadyStateSpecies()
+	{
+		speciesByWorstAdjustedFitness_.clear();
+		steadyStateSelectionWeights_.clear();
+		breedableSpecies_.clear();
+		for (auto& species : steadyStateSpecies_)
 		{
-			species.reset();
+			species.ranked = false;
+			species.selectionWeight = 0;
+			steadyStateSelectionWeights_.push_back(0.0);
+			breedableSpecies_.push_back(0);
 		}
 
-		genomes_ = std::move(nextGenGenomes);
-		for (auto& g : genomes_)
-			g.reconnectIncommingPointers();
+		for (size_t s = 0; s < steadyStateSpecies_.size(); s++)
+			rankSteadyStateSpecies(s);
 	}
 
-	//void Evaluator::evaluate_training()
-	//{
-	//	
-	//}
+	/// <summary>
+	/// Updates where the species stands among the others after its available members or member count changed, in O(log S).
+	/// </summary>
+	void Evaluator::rankSteadyStateSpecies(size_t speciesIndex)
+	{
+		auto& species = steadyStateSpecies_[speciesIndex];
+		if (species.ranked)
+			speciesByWorstAdjustedFitness_.erase({ species.worstAdjustedFitness, speciesIndex });
 
-	void Evaluator::evaluate_testing()
+		const bool breedable = !species.available.empty();
+		breedableSpecies_.add(speciesIndex, int64_t{ breedable } - int64_t{ species.ranked });
+		species.ranked = breedable;
+
+		const double selectionWeight = breedable ? species.fitnessSum / species.memberCount : 0.0;
+		steadyStateSelectionWeights_.add(speciesIndex, selectionWeight - species.selectionWeight);
+		species.selectionWeight = selectionWeight;
+
+		if (breedable)
+		{
+			species.worstAdjustedFitness = species.byFitness.begin()->first / species.memberCount;
+			speciesByWorstAdjustedFitness_.emplace(species.worstAdjustedFitness, speciesIndex);
+		}
+	}
+
+	/// <summary>
+	/// Picks a species with available members, biased by adjusted fitness sum like getRandomSpeciesBiasedAdjustedFitness, or uniformly if none of them has any.
+	/// </summary>
+	/// <returns>The index of the species in species_. </returns>
+	size_t Evaluator::getRandomSteadyStateSpecies(std::mt19937& gen) const
 	{
+		assert(breedableSpecies_.total() > 0 && "No species has genomes to breed from!");
+
+		const double totalWeight = steadyStateSelectionWeights_.total();
+		if (totalWeight > 0)
+		{
+			double remainder;
+			const size_t s = steadyStateSelectionWeights_.find(std::uniform_real_distribution<double>(0.0, totalWeight)(gen), remainder);
+
+			// Rounding errors in the sums can leave a tiny weight on a species without available members, which is passed over.
+			if (steadyStateSpecies_[s].ranked)
+				return s;
+		}
+
+		int64_t remainder;
+		return breedableSpecies_.find(std::uniform_int_distribution<int64_t>(0, breedableSpecies_.total() - 1)(gen), remainder);
 	}
 
 	void Evaluator::computeAdjustedFitnessSums()
 	{
 		totalAdjustedFitness_ = 0;
+		adjustedFitnesses_.resize(genomes_.size());
 
 		for (auto& s : species_)
 		{
@@ -190,9 +345,11 @@ namespace neat
 
 			s.generationsSinceLastImprovement++;
 
-			for (auto& g : s.memberGenomes)
+			for (size_t m = s.memberBegin; m < s.memberEnd; m++)
 			{
+				const size_t g = speciesMembers_[m];
 				auto adjustedFitness = getAdjustedFitness(g);
+				adjustedFitnesses_[g] = adjustedFitness;
 
 				s.adjustedFitnessSum += adjustedFitness;
 				totalAdjustedFitness_ += adjustedFitness;
@@ -205,60 +362,601 @@ namespace neat
 		}
 	}
 
-	const Evaluator::Species* Evaluator::getRandomSpeciesBiasedAdjustedFitness() const
+	/// <summary>
+	/// Fills speciesSelectionSums_ from the weight (adjusted fitness sum) of every species. Species without genomes to breed from (canBreed(speciesIndex) is false) can't be picked.
+	/// If none of the other species has any fitness, they are all equally likely to be picked.
+	/// </summary>
+	template<typename Weight, typename CanBreed>
+	void Evaluator::buildSpeciesSelectionTable(Weight weight, CanBreed canBreed)
+	{
+		speciesSelectionSums_.clear();
+		double totalWeight = 0;
+		for (size_t s = 0; s < species_.size(); s++)
+		{
+			// The weights are only summed once, and kept in the table until the fallback is known.
+			speciesSelectionSums_.push_back(canBreed(s) ? static_cast<double>(weight(s)) : 0.0);
+			totalWeight += speciesSelectionSums_.back();
+		}
+
+		double sum = 0;
+		for (size_t s = 0; s < species_.size(); s++)
+		{
+			if (canBreed(s))
+				sum += totalWeight > 0 ? speciesSelectionSums_[s] : 1.0;
+
+			speciesSelectionSums_[s] = sum;
+		}
+
+		assert(sum > 0 && "No species has genomes to breed from!");
+	}
+
+	size_t Evaluator::getRandomSpeciesBiasedAdjustedFitness(std::mt19937& gen) const
+	{
+		const double total = speciesSelectionSums_.back();
+		const double random = std::uniform_real_distribution<double>(0.0, total)(gen);
+
+		// The species is the first one whose sum is greater than the random number. Species that can't be picked have the same sum as the one before them, so they are never first.
+		auto it = std::upper_bound(speciesSelectionSums_.begin(), speciesSelectionSums_.end(), random);
+
+		// Rounding can put the random number at the very end, which belongs to the last species that can be picked.
+		if (it == speciesSelectionSums_.end())
+			it = std::lower_bound(speciesSelectionSums_.begin(), speciesSelectionSums_.end(), total);
+
+		return it - speciesSelectionSums_.begin();
+	}
+
+	/// <summary>
+	/// Mutates the genomes [begin, end), like Genome::mutate. The weights of all of them are mutated in one batch, before any structural mutations.
+	/// </summary>
+	void Evaluator::mutateGenomes(std::vector<Genome>& genomes, size_t begin, size_t end)
 	{
 		// Create randomizer helpers
 		std::random_device rd;
 		std::mt19937 gen(rd());
+		std::uniform_real_distribution<float> dis0_1(0.0f, 1.0f);
 
-		std::uniform_real_distribution<float> dis(0, totalAdjustedFitness_);
+		weightMutatedGenomes_.clear();
+		for (size_t i = begin; i < end; i++)
+		{
+			if (dis0_1(gen) < mutateWeightChance_)
+				weightMutatedGenomes_.push_back(&genomes[i]);
+		}
+		Genome::mutateConnectionGenes(weightMutatedGenomes_, &threadPool_);
 
-		// Get random number
-		float random = dis(gen);
+		// Structural mutations only share the (thread safe) innovation registry and topology table.
+		threadPool_.parallelFor(end - begin, [this, &genomes, begin](size_t i) { genomes[begin + i].mutate(0.0f, mutateAddNodeChance_, mutateAddConnectionChance_); });
+	}
 
-		// Sum the total adjusted fitness of each species, until it is greater than or equal to the random number.
-		float sum = 0;
-		for (auto& s : species_)
+	/// <summary>
+	/// Places every genome into the first species whose mascot is close enough, or into a new species if there is none, and removes the species that end up empty.
+	/// The genomes are compared with the existing species in parallel. Only the genomes that fit none of them are handled one by one, since they can found new species that later genomes join.
+	/// The result is the same as placing the genomes one by one, in order.
+	/// </summary>
+	void Evaluator::speciate()
+	{
+		const size_t existingSpeciesCount = species_.size();
+		speciesIds_.assign(genomes_.size(), noSpecies_c);
+
+		// The mascots may have changed since the species were last indexed.
+		indexSpecies();
+
+		threadPool_.parallelFor(genomes_.size(), [&](size_t g) { speciesIds_[g] = findCompatibleSpecies(genomes_[g], 0, existingSpeciesCount); }, speciationGrainSize_c);
+
+		// New species come after all existing ones, so a genome that fits an existing species never looks at them.
+		for (size_t g = 0; g < genomes_.size(); g++)
 		{
-			sum += s.adjustedFitnessSum;
+			if (speciesIds_[g] != noSpecies_c)
+				continue;
 
-			if (sum >= random)
-				return &s;
+			speciesIds_[g] = findCompatibleSpecies(genomes_[g], existingSpeciesCount, species_.size());
+
+			// The new species starts out with the genome as its mascot.
+			if (speciesIds_[g] == noSpecies_c)
+			{
+				speciesIds_[g] = species_.size();
+				species_.emplace_back(genomes_[g]);
+				addToSpeciesIndex(speciesIds_[g]);
+			}
 		}
 
-		// If this point is reached, something went wrong.
-		return nullptr;
+		groupSpeciesMembers();
 	}
 
-	void Evaluator::calculateFitnessMap()
+	/// <summary>
+	/// Fills the member ranges of the species from speciesIds_, and removes the species that have no members.
+	/// </summary>
+	void Evaluator::groupSpeciesMembers()
 	{
-		fitnessMap_.clear();
-		for (auto& g : genomes_)
+		// Group the members by species (in genome order within each species): count them, give every species its range, and fill the ranges.
+		for (auto& species : species_)
+			species.memberBegin = species.memberEnd = 0;
+		for (auto s : speciesIds_)
+			species_[s].memberEnd++;
+
+		size_t memberOffset = 0;
+		for (auto& species : species_)
 		{
-			g.reconnectIncommingPointers();
-			float fitness = evaluateGenomeTraining(g);
+			species.memberBegin = memberOffset;
+			memberOffset += species.memberEnd;
+			species.memberEnd = species.memberBegin;
+		}
+
+		speciesMembers_.resize(genomes_.size());
+		for (size_t g = 0; g < genomes_.size(); g++)
+			speciesMembers_[species_[speciesIds_[g]].memberEnd++] = g;
 
-			fitnessMap_[&g] = fitness;
+		// Check if every species has members, remove any that don't. That shifts the species, so the ids are assigned again.
+		const size_t speciesCount = species_.size();
+		species_.erase(std::remove_if(species_.begin(), species_.end(), [](const Species& species) { return species.memberCount() == 0; }), species_.end());
+		if (species_.size() != speciesCount)
+			indexSpecies();
+
+		for (size_t s = 0; s < species_.size(); s++)
+		{
+			for (size_t m = species_[s].memberBegin; m < species_[s].memberEnd; m++)
+				speciesIds_[speciesMembers_[m]] = s;
 		}
 	}
 
-	Evaluator::Species::Species(Genome* mascot)
-		: mascot{ *mascot }, memberGenomes{ mascot }
+	/// <summary>
+	/// Places the genome into the first species whose mascot is close enough, or into a new species if there is none. Only used by steady-state evolution, so a new species gets its SteadyStateSpecies too.
+	/// </summary>
+	/// <returns>The index of the species in species_. </returns>
+	size_t Evaluator::placeInSpecies(const Genome& genome)
 	{
+		const size_t s = findCompatibleSpecies(genome, 0, species_.size());
+		if (s != noSpecies_c)
+			return s;
+
+		species_.emplace_back(genome);
+		steadyStateSpecies_.emplace_back();
+		steadyStateSelectionWeights_.push_back(0.0);
+		breedableSpecies_.push_back(0);
+		addToSpeciesIndex(species_.size() - 1);
+		return species_.size() - 1;
 	}
 
-	void Evaluator::Species::reset()
+	void Evaluator::indexSpecies()
 	{
-		// Create randomizer helpers
-		std::random_device rd;
-		std::mt19937 gen(rd());
-		std::uniform_int_distribution<size_t> dis(0ULL, memberGenomes.size() - 1);
+		speciesByConnectionCount_.clear();
+		if (!connectionCountBandActive_)
+			return;
+
+		for (size_t s = 0; s < species_.size(); s++)
+			speciesByConnectionCount_.emplace_back(species_[s].mascot.numberOfConnections(), s);
+		std::sort(speciesByConnectionCount_.begin(), speciesByConnectionCount_.end());
+	}
+
+	void Evaluator::addToSpeciesIndex(size_t speciesIndex)
+	{
+		if (!connectionCountBandActive_)
+			return;
 
-		// Randomly select a genome from the species and make it the mascot
-		mascot = *memberGenomes[dis(gen)];
+		const std::pair<size_t, size_t> entry{ species_[speciesIndex].mascot.numberOfConnections(), speciesIndex };
+		speciesByConnectionCount_.insert(std::upper_bound(speciesByConnectionCount_.begin(), speciesByConnectionCount_.end(), entry), entry);
+	}
+
+	/// <summary>
+	/// A genome with n connections and a mascot with m have at least |n - m| non-matching genes, so their distance is at least minConst * |n - m| / max(n, m), with minConst = min(excessConst, disjointConst).
+	/// If the cutoff is below minConst, that only leaves the mascots with n * (1 - cutoff / minConst) < m < n / (1 - cutoff / minConst), which are checked in species order. Otherwise every species is.
+	/// Larger cutoffs (like the default 3 with constants of 1) can't be pruned by structure at all: two genomes have at most n + m <= 2 * max(n, m) non-matching genes, so the excess and disjoint terms
+	/// never add up to more than 2 * max(excessConst, disjointConst). Species are then told apart by their weights, and every species is compared, each comparison stopping early once it passes the cutoff.
+	/// The result is the same as checking every species in order.
+	/// </summary>
+	size_t Evaluator::findCompatibleSpecies(const Genome& genome, size_t speciesBegin, size_t speciesEnd) const
+	{
+		auto candidatesBegin = speciesByConnectionCount_.begin();
+		auto candidatesEnd = speciesByConnectionCount_.end();
+		if (connectionCountBandActive_)
+		{
+			const float minConst = std::min(excessConst_, disjointConst_);
+			// Rounded outwards, so rounding errors can't rule out a compatible species.
+			const double keptFraction = 1.0 - static_cast<double>(compatibilityDistanceCutoff_) / minConst;
+			const double count = static_cast<double>(genome.numberOfConnections());
+			const size_t lowest = static_cast<size_t>(std::floor(count * keptFraction));
+			const double highest = std::ceil(count / keptFraction);
+			candidatesBegin = std::lower_bound(candidatesBegin, candidatesEnd, std::pair<size_t, size_t>{ lowest, 0 });
+			if (highest < static_cast<double>(SIZE_MAX))
+				candidatesEnd = std::upper_bound(candidatesBegin, candidatesEnd, std::pair<size_t, size_t>{ static_cast<size_t>(highest), SIZE_MAX });
+		}
+
+		// Without much to rule out, a plain scan is cheaper than sorting the candidates.
+		if (!connectionCountBandActive_ || static_cast<size_t>(candidatesEnd - candidatesBegin) >= speciesEnd - speciesBegin)
+		{
+			for (size_t s = speciesBegin; s < speciesEnd; s++)
+			{
+				if (isCompatible(species_[s], genome))
+					return s;
+			}
+			return noSpecies_c;
+		}
+
+		thread_local std::vector<size_t> candidates;
+		candidates.clear();
+		for (auto it = candidatesBegin; it != candidatesEnd; ++it)
+		{
+			if (it->second >= speciesBegin && it->second < speciesEnd)
+				candidates.push_back(it->second);
+		}
+		std::sort(candidates.begin(), candidates.end());
+
+		for (auto s : candidates)
+		{
+			if (isCompatible(species_[s], genome))
+				return s;
+		}
+		return noSpecies_c;
+	}
+
+	bool Evaluator::isCompatible(const Species& species, const Genome& genome) const
+	{
+		// Most genomes don't belong to most species, so the distance calculation is allowed to stop early once it passes the cutoff.
+		return species.mascot.calculateCompatibilityDistance(genome, excessConst_, disjointConst_, weightDiffConst_, compatibilityDistanceCutoff_) < compatibilityDistanceCutoff_;
+	}
+
+	/// <summary>
+	/// Decides where the elite (the best member of every species with 5 or more members) and the survivors (the rest of the best half) of each species go in nextGenomes_: all elites first, then all survivors, in species order.
+	/// Those places are the parents of each species (parentIndices_). After them come the offspring of each species (offspringOffsets_), and then the few offspring of two species.
+	/// How many offspring a species breeds is decided before any genome is evaluated, by the predicted adjusted fitness of the species, so every species can be handled on its own once its members are evaluated (see selectSurvivors and breedSpecies).
+	/// </summary>
+	void Evaluator::planSurvivors(std::mt19937& gen)
+	{
+		size_t eliteCount = 0;
+		for (const auto& s : species_)
+			eliteCount += s.memberCount() > 4;
+
+		// There are never more parents than genomes, so reserving that many keeps the number of survivors from reallocating them whenever it grows.
+		// The same goes for the offspring of two species, which only a few generations have.
+		parentIndices_.clear();
+		parentIndices_.reserve(genomes_.size());
+		parentFitnesses_.reserve(genomes_.size());
+		parentPairs_.reserve(genomes_.size());
+		parents_.reserve(genomes_.size());
+		weightMutatedGenomes_.reserve(genomes_.size());
+		parentOffsets_.clear();
+		size_t nextElite = 0;
+		size_t nextSurvivor = eliteCount;
+		for (const auto& s : species_)
+		{
+			parentOffsets_.push_back(parentIndices_.size());
+			if (s.memberCount() > 4)
+				parentIndices_.push_back(nextElite++);
+
+			for (size_t i = 1; i < s.memberCount() / 2; i++)
+				parentIndices_.push_back(nextSurvivor++);
+		}
+		parentOffsets_.push_back(parentIndices_.size());
+
+		firstSurvivor_ = eliteCount;
+		parentFitnesses_.resize(nextSurvivor);
+
+		// The next generation overwrites the genomes of the previous one, which reuses their memory.
+		nextGenomes_.resize(genomes_.size());
+		nextPredictedFitnesses_.resize(genomes_.size());
+
+		// Steady-state evolution leaves the actual fitness of every genome. A population that was never evaluated has no prediction, so every species is equally likely to breed.
+		if (fitnessesCurrent_)
+			predictedFitnesses_ = fitnesses_;
+		else if (predictedFitnesses_.size() != genomes_.size())
+			predictedFitnesses_.assign(genomes_.size(), 0.0f);
+
+		buildSpeciesSelectionTable([this](size_t s)
+			{
+				double predictedFitnessSum = 0;
+				for (size_t m = species_[s].memberBegin; m < species_[s].memberEnd; m++)
+					predictedFitnessSum += predictedFitnesses_[speciesMembers_[m]];
+				return predictedFitnessSum / species_[s].memberCount();
+			}, [this](size_t s) { return parentOffsets_[s + 1] > parentOffsets_[s]; });
+
+		// Every offspring picks a species, or has a 0.1% chance to cross-breed between species.
+		offspringOffsets_.assign(species_.size() + 1, 0);
+		offspringOffsets_[0] = nextSurvivor;
+		std::uniform_real_distribution<float> dis0_1(0.0f, 1.0f);
+		for (size_t i = nextSurvivor; i < genomes_.size(); i++)
+		{
+			if (dis0_1(gen) >= 0.001f)
+				offspringOffsets_[getRandomSpeciesBiasedAdjustedFitness(gen) + 1]++;
+		}
+		for (size_t s = 0; s < species_.size(); s++)
+			offspringOffsets_[s + 1] += offspringOffsets_[s];
+	}
+
+	/// <summary>
+	/// Sorts the members of the species by fitness, and copies its elite and survivors to their places in nextGenomes_ (see planSurvivors). The survivors are mutated, the elite isn't.
+	/// Runs while other species are still being evaluated, so it only touches the members and places of this species.
+	/// </summary>
+	void Evaluator::selectSurvivors(size_t speciesIndex)
+	{
+		const auto& species = species_[speciesIndex];
+		std::sort(speciesMembers_.begin() + species.memberBegin, speciesMembers_.begin() + species.memberEnd, [this](size_t g1, size_t g2)
+			{
+				return fitnesses_[g1] > fitnesses_[g2];
+			});
+
+		// The elite is the best member, and the survivors are the ones after it.
+		size_t rank = species.memberCount() > 4 ? 0 : 1;
+		for (size_t p = parentOffsets_[speciesIndex]; p < parentOffsets_[speciesIndex + 1]; p++, rank++)
+		{
+			const size_t next = parentIndices_[p];
+			const size_t member = speciesMembers_[species.memberBegin + rank];
+			nextGenomes_[next] = genomes_[member];
+			parentFitnesses_[next] = fitnesses_[member];
+			nextPredictedFitnesses_[next] = fitnesses_[member];
+
+			if (next >= firstSurvivor_)
+				nextGenomes_[next].mutate(mutateWeightChance_, mutateAddNodeChance_, mutateAddConnectionChance_);
+		}
+	}
+
+	/// <summary>
+	/// Breeds the offspring of the species (see planSurvivors) from its parents in nextGenomes_, and mutates them. Like selectSurvivors, it runs while other species are still being evaluated, right after selectSurvivors placed the parents.
+	/// </summary>
+	void Evaluator::breedSpecies(size_t speciesIndex)
+	{
+		if (offspringOffsets_[speciesIndex] == offspringOffsets_[speciesIndex + 1])
+			return;
+
+		// Each thread keeps its own generator, so it's only seeded once.
+		thread_local std::mt19937 gen{ std::random_device{}() };
+		std::uniform_int_distribution<size_t> dis(parentOffsets_[speciesIndex], parentOffsets_[speciesIndex + 1] - 1);
+		for (size_t child = offspringOffsets_[speciesIndex]; child < offspringOffsets_[speciesIndex + 1]; child++)
+		{
+			auto g1 = parentIndices_[dis(gen)];
+			auto g2 = parentIndices_[dis(gen)];
+
+			// The more fit parent should always be the first parameter.
+			if (!(parentFitnesses_[g1] > parentFitnesses_[g2]))
+				std::swap(g1, g2);
+
+			nextGenomes_[child].breedFrom(nextGenomes_[g1], nextGenomes_[g2]).mutate(mutateWeightChance_, mutateAddNodeChance_, mutateAddConnectionChance_);
+			nextPredictedFitnesses_[child] = parentFitnesses_[g1];
+		}
+	}
+
+	void Evaluator::calculateFitnesses()
+	{
+		evaluateGenomes(false);
+	}
+
+	/// <summary>
+	/// Calculates the fitness of every genome. Only the genomes that aren't in the fitness cache are evaluated, and identical genomes are only evaluated once.
+	/// The evaluations run in parallel, starting with the ones the cost model predicts to be the most expensive, so no expensive genome is left to start at the very end.
+	/// Genomes that would take much longer than the rest are split over several threads, if the subclass allows it.
+	/// With reproduceEarly, each species is passed to selectSurvivors and breedSpecies by whichever thread completes the fitness of its last member, while the other threads keep evaluating (planSurvivors has to be called first).
+	/// </summary>
+	void Evaluator::evaluateGenomes(bool reproduceEarly)
+	{
+		fitnesses_.resize(genomes_.size());
+		fitnessSources_.resize(genomes_.size());
+		firstDuplicates_.assign(genomes_.size(), noGenome_c);
+		nextDuplicates_.resize(genomes_.size());
+		evaluatedIndices_.clear();
+
+		// Genomes identical to one that was evaluated before (like the elites) don't have to be evaluated again, and neither do copies within this generation.
+		// Without a cache, the fitness might not be deterministic, so every genome is evaluated.
+		const bool reuseFitness = fitnessCache_.capacity() > 0;
+		evaluatedByHash_.clear();
+		for (size_t i = 0; i < genomes_.size(); i++)
+		{
+			const Genome& genome = genomes_[i];
+			fitnessSources_[i] = i;
+
+			if (!reuseFitness)
+			{
+				evaluatedIndices_.push_back(i);
+				continue;
+			}
+
+			if (auto cachedFitness = fitnessCache_.find(genome))
+			{
+				fitnesses_[i] = *cachedFitness;
+				continue;
+			}
+
+			auto [it, inserted] = evaluatedByHash_.try_emplace(genome.hash(), i);
+			if (!inserted && genomes_[it->second] == genome)
+			{
+				fitnessSources_[i] = it->second;
+				nextDuplicates_[i] = firstDuplicates_[it->second];
+				firstDuplicates_[it->second] = i;
+				continue;
+			}
+
+			evaluatedIndices_.push_back(i);
+		}
+
+		createEvaluationTasks();
+
+		// Count what every genome, and every species, is still waiting for.
+		if (remainingTasks_.size() < genomes_.size())
+			remainingTasks_ = std::vector<std::atomic<uint32_t>>(genomes_.size());
+		for (auto i : evaluatedIndices_)
+			remainingTasks_[i].store(0, std::memory_order_relaxed);
+		for (const auto& task : evaluationTasks_)
+			remainingTasks_[task.genomeIndex].fetch_add(1, std::memory_order_relaxed);
+
+		readySpecies_.clear();
+		if (reproduceEarly)
+		{
+			if (remainingMembers_.size() < species_.size())
+				remainingMembers_ = std::vector<std::atomic<uint32_t>>(species_.size());
+			for (size_t s = 0; s < species_.size(); s++)
+				remainingMembers_[s].store(0, std::memory_order_relaxed);
+			for (size_t i = 0; i < genomes_.size(); i++)
+			{
+				if (fitnessSources_[i] != i || remainingTasks_[i].load(std::memory_order_relaxed) > 0)
+					remainingMembers_[speciesIds_[i]].fetch_add(1, std::memory_order_relaxed);
+			}
+			for (size_t s = 0; s < species_.size(); s++)
+			{
+				if (remainingMembers_[s].load(std::memory_order_relaxed) == 0)
+					readySpecies_.push_back(s);
+			}
+		}
+
+		// Only the thread that takes a count to 0 goes on, and the counts are changed with acquire-release ordering, so it sees the fitness of every genome the count waited for.
+		const auto reproduce = [this](size_t speciesIndex)
+		{
+			selectSurvivors(speciesIndex);
+			breedSpecies(speciesIndex);
+		};
+		const auto genomeCompleted = [this, reproduceEarly, &reproduce](size_t genomeIndex)
+		{
+			if (reproduceEarly && remainingMembers_[speciesIds_[genomeIndex]].fetch_sub(1, std::memory_order_acq_rel) == 1)
+				reproduce(speciesIds_[genomeIndex]);
+		};
+
+		// Species whose members all came from the cache are handled after every evaluation has started, by threads that would otherwise be idle.
+		const size_t taskCount = evaluationTasks_.size();
+		threadPool_.parallelForInOrder(taskCount + readySpecies_.size(), [this, taskCount, &reproduce, &genomeCompleted](size_t i)
+			{
+				if (i >= taskCount)
+				{
+					reproduce(readySpecies_[i - taskCount]);
+					return;
+				}
+
+				auto& task = evaluationTasks_[i];
+				const auto start = std::chrono::steady_clock::now();
+
+				if (task.sampleBegin == task.sampleEnd)
+				{
+					task.fitness = evaluateGenomeTraining(genomes_[task.genomeIndex]);
+				}
+				else
+				{
+					// Chunks of the same genome run at the same time, so each gets its own copy (which shares the topology).
+					Genome genome = genomes_[task.genomeIndex];
+					task.fitness = evaluateGenomeTrainingSamples(genome, task.sampleBegin, task.sampleEnd);
+				}
+
+				task.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+				// The last task of a genome to finish completes its fitness, and that of its duplicates.
+				const size_t genomeIndex = task.genomeIndex;
+				if (remainingTasks_[genomeIndex].fetch_sub(1, std::memory_order_acq_rel) != 1)
+					return;
+
+				fitnesses_[genomeIndex] = task.sampleBegin == task.sampleEnd ? task.fitness : combineChunkFitnesses(genomeIndex);
+				genomeCompleted(genomeIndex);
+				for (size_t d = firstDuplicates_[genomeIndex]; d != noGenome_c; d = nextDuplicates_[d])
+				{
+					fitnesses_[d] = fitnesses_[genomeIndex];
+					genomeCompleted(d);
+				}
+			});
+
+		// Calibrate the cost model with the measured time of every genome.
+		std::sort(evaluationTasks_.begin(), evaluationTasks_.end(), [](const EvaluationTask& a, const EvaluationTask& b)
+			{
+				return a.genomeIndex != b.genomeIndex ? a.genomeIndex < b.genomeIndex : a.sampleBegin < b.sampleBegin;
+			});
+
+		for (size_t first = 0; first < evaluationTasks_.size();)
+		{
+			const size_t genomeIndex = evaluationTasks_[first].genomeIndex;
+			size_t last = first;
+			double seconds = 0;
+			for (; last < evaluationTasks_.size() && evaluationTasks_[last].genomeIndex == genomeIndex; last++)
+				seconds += evaluationTasks_[last].seconds;
+
+			costModel_.addMeasurement(genomes_[genomeIndex], seconds);
+
+			first = last;
+		}
+		costModel_.update();
+
+		for (auto i : evaluatedIndices_)
+			fitnessCache_.insert(genomes_[i], fitnesses_[i]);
+	}
+
+	/// <summary>
+	/// Combines the fitness of every chunk of the genome, once they have all been evaluated.
+	/// Only few genomes are split, so their chunks are simply looked up. Chunks with the same cost are sorted by sample, so they are found in sample order.
+	/// </summary>
+	float Evaluator::combineChunkFitnesses(size_t genomeIndex) const
+	{
+		// Several genomes can complete at the same time, so each thread has its own list.
+		thread_local std::vector<float> chunkFitnesses;
+		chunkFitnesses.clear();
+		for (const auto& task : evaluationTasks_)
+		{
+			if (task.genomeIndex == genomeIndex)
+				chunkFitnesses.push_back(task.fitness);
+		}
+
+		return combineTrainingFitness(chunkFitnesses);
+	}
+
+	/// <summary>
+	/// Creates the evaluation tasks of the genomes in evaluatedIndices_, sorted from most to least expensive (longest processing time first).
+	/// </summary>
+	void Evaluator::createEvaluationTasks()
+	{
+		evaluationTasks_.clear();
+
+		double totalCost = 0;
+		for (auto i : evaluatedIndices_)
+		{
+			const double cost = costModel_.predict(genomes_[i]);
+			evaluationTasks_.push_back({ i, cost });
+			totalCost += cost;
+		}
+
+		// A genome that takes longer than a large part of what each thread has to do anyway would hold up the end of the generation, so it is split into one chunk per thread.
+		const size_t threadCount = threadPool_.threadCount();
+		const size_t sampleCount = trainingSampleCount();
+		if (threadCount > 1 && sampleCount > 1)
+		{
+			const double splitCost = splitCostFraction_c * totalCost / threadCount;
+			const size_t chunkCount = std::min(threadCount, sampleCount);
+
+			const size_t taskCount = evaluationTasks_.size();
+			for (size_t t = 0; t < taskCount; t++)
+			{
+				auto& task = evaluationTasks_[t];
+				if (task.predictedCost <= splitCost)
+					continue;
+
+				const size_t genomeIndex = task.genomeIndex;
+				const double chunkCost = task.predictedCost / chunkCount;
+				task = { genomeIndex, chunkCost, 0, sampleCount / chunkCount };
+				for (size_t c = 1; c < chunkCount; c++)
+					evaluationTasks_.push_back({ genomeIndex, chunkCost, sampleCount * c / chunkCount, sampleCount * (c + 1) / chunkCount });
+			}
+		}
+
+		// Ties are broken by genome and chunk, so the order doesn't depend on the sort (std::stable_sort would allocate a buffer every generation).
+		std::sort(evaluationTasks_.begin(), evaluationTasks_.end(), [](const EvaluationTask& a, const EvaluationTask& b)
+			{
+				if (a.predictedCost != b.predictedCost)
+					return a.predictedCost > b.predictedCost;
+				return a.genomeIndex != b.genomeIndex ? a.genomeIndex < b.genomeIndex : a.sampleBegin < b.sampleBegin;
+			});
+	}
+
+	float Evaluator::evaluateGenomeTrainingSamples(Genome&, size_t, size_t)
+	{
+		assert(false && "Subclasses that return a trainingSampleCount have to override evaluateGenomeTrainingSamples!");
+		return 0.0f;
+	}
+
+	float Evaluator::combineTrainingFitness(const std::vector<float>& chunkFitnesses) const
+	{
+		return std::accumulate(chunkFitnesses.begin(), chunkFitnesses.end(), 0.0f);
+	}
+
+	Evaluator::Species::Species(const Genome& mascot)
+		: mascot{ mascot }
+	{
+	}
+
+	void Evaluator::Species::reset(const Genome& newMascot)
+	{
+		mascot = newMascot;
 
 		// Clear the member genomes
-		memberGenomes.clear();
+		memberBegin = memberEnd = 0;
 		adjustedFitnessSum = 0;
 	}
 
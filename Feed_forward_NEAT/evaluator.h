@@ -2,9 +2,17 @@
 #define EVALUATOR_H
 
 #include "NEAT.h"
+#include "fitness_cache.h"
+#include "flat_hash_map.h"
+#include "thread_pool.h"
+#include "cost_model.h"
+#include "fenwick_tree.h"
 
-#include <unordered_map>
 #include <memory>
+#include <atomic>
+#include <random>
+#include <set>
+#include <cstdint>
 
 namespace neat
 {
@@ -21,7 +29,9 @@ namespace neat
 		struct Species
 		{
 			Genome mascot;
-			std::vector<Genome*> memberGenomes{};
+			// The members are the genome indices speciesMembers_[memberBegin, memberEnd) of the evaluator, from most to least fit once they are evaluated.
+			size_t memberBegin = 0;
+			size_t memberEnd = 0;
 
 			float adjustedFitnessSum = 0;
 
@@ -29,21 +39,31 @@ namespace neat
 			size_t generationsSinceLastImprovement = 0;
 
 			// Constructors
-			Species(Genome* mascot);
+			Species(const Genome& mascot);
 
 			// Public methods
-			void reset();
+			void reset(const Genome& newMascot);
+
+			// Getters
+			[[nodiscard]] inline size_t memberCount() const { return memberEnd - memberBegin; };
 		};
 
 	public:
-		explicit Evaluator(size_t populationSize, const float compatibilityDistanceCutoff = 3.0f, const float excessConst = 1.0f, const float disjointConst = 1.0f, const float weightDiffConst = 0.4f);
+		// Genomes identical to a recently evaluated one, or to another genome being evaluated, reuse its fitness, which assumes that evaluateGenomeTraining is deterministic.
+		// A fitnessCacheCapacity of 0 disables this, so every genome is evaluated.
+		// Evaluation, mutation and reproduction run on a pool of threadCount threads (0 uses every hardware thread), see evaluateGenomeTraining.
+		// Only one thread by default, since subclasses have to opt in to having evaluateGenomeTraining called from several threads at once.
+		explicit Evaluator(size_t populationSize, const float compatibilityDistanceCutoff = 3.0f, const float excessConst = 1.0f, const float disjointConst = 1.0f, const float weightDiffConst = 0.4f, const size_t fitnessCacheCapacity = 4096, const size_t threadCount = 1);
 
 		// Public methods
 		void evaluate_training();
 		void evaluate_testing();
+		// Steady-state (rtNEAT style) evolution: replaces replacementCount genomes one at a time, with no generations for the threads to wait for.
+		void evaluate_steadyState(size_t replacementCount);
 
 		// Getters
 		[[nodiscard]] inline size_t populationSize() const { return genomes_.size(); };
+		[[nodiscard]] inline size_t speciesCount() const { return species_.size(); };
 
 	private:
 		const float compatibilityDistanceCutoff_;
@@ -51,25 +71,185 @@ namespace neat
 		const float disjointConst_;
 		const float weightDiffConst_;
 
+		// Connections that stay disabled for this many generations are removed from the genomes.
+		static constexpr uint32_t maxDisabledGenerations_c = 20;
 
 		std::vector<Species> species_{};
-		std::unordered_map<Genome*, Species*> speciesMap_{};
+		// Per genome index, the index of its species in species_.
+		std::vector<size_t> speciesIds_{};
+		// The genome indices of every species, one species after the other (see Species::memberBegin).
+		std::vector<size_t> speciesMembers_{};
+		static constexpr size_t noSpecies_c = SIZE_MAX;
+		// Comparing a genome with every species is cheap, so the threads take a few genomes at a time.
+		static constexpr size_t speciationGrainSize_c = 16;
+		// The species as (number of connections of the mascot, species index) pairs, sorted. The gene counts alone bound the compatibility distance, so a small enough cutoff leaves only a band of them to compare with (see findCompatibleSpecies).
+		// Only kept if the cutoff is small enough for that (connectionCountBandActive_).
+		std::vector<std::pair<size_t, size_t>> speciesByConnectionCount_{};
+		const bool connectionCountBandActive_;
 
 		float totalAdjustedFitness_ = 0;
 
+		FitnessCache fitnessCache_;
+		ThreadPool threadPool_;
+
+		/// <summary>
+		/// The evaluation of (part of) one genome. Genomes are only split into several tasks if the subclass allows it, see trainingSampleCount.
+		/// </summary>
+		struct EvaluationTask
+		{
+			size_t genomeIndex;
+			double predictedCost;
+			// The training samples to evaluate, or an empty range for the whole genome with evaluateGenomeTraining.
+			size_t sampleBegin = 0;
+			size_t sampleEnd = 0;
+
+			float fitness = 0;
+			double seconds = 0;
+		};
+
+		// Genomes that are predicted to take longer than this fraction of a whole thread's share of the generation are split into chunks (if the subclass allows it).
+		static constexpr double splitCostFraction_c = 0.5;
+
+		EvaluationCostModel costModel_{};
+
+		// Per genome index, the fitness of the last calculateFitnesses call, and that fitness divided by the size of the species. Kept between generations, so they don't have to be allocated again.
+		std::vector<float> fitnesses_{};
+		std::vector<float> adjustedFitnesses_{};
+		// The genomes that actually have to be evaluated, and per genome, the genome with the same fitness (itself, if it was evaluated).
+		std::vector<size_t> evaluatedIndices_{};
+		std::vector<size_t> fitnessSources_{};
+		// Per evaluated genome, its duplicates as a linked list: the first one, and per duplicate, the next one (noGenome_c ends the list).
+		std::vector<size_t> firstDuplicates_{};
+		std::vector<size_t> nextDuplicates_{};
+		static constexpr size_t noGenome_c = SIZE_MAX;
+		// Sorted from most to least expensive.
+		std::vector<EvaluationTask> evaluationTasks_{};
+		// While evaluating, per genome index the number of its tasks that haven't finished, and per species the number of members without a fitness yet.
+		// Only reallocated when they have to grow (atomics can't be moved).
+		std::vector<std::atomic<uint32_t>> remainingTasks_{};
+		std::vector<std::atomic<uint32_t>> remainingMembers_{};
+		// The species whose members all got their fitness from the cache, so they don't wait for any evaluation.
+		std::vector<size_t> readySpecies_{};
+
+		// The next generation is built here, and then swapped with genomes_. It overwrites the genomes of two generations ago, so copying and breeding genomes reuses their memory instead of allocating.
+		std::vector<Genome> nextGenomes_{};
+		// Per genome index, the fitness it is expected to have before it is evaluated: that of the genome it was copied from, or of its more fit parent. Kept for the next generation the same way.
+		std::vector<float> predictedFitnesses_{};
+		std::vector<float> nextPredictedFitnesses_{};
+
+		// While breeding, the genomes of the next generation that can become parents (indices into the next generation), grouped by species: those of species s are parentIndices_[parentOffsets_[s], parentOffsets_[s + 1]).
+		std::vector<size_t> parentIndices_{};
+		std::vector<size_t> parentOffsets_{};
+		// The elites (which aren't mutated) come before every other parent in the next generation.
+		size_t firstSurvivor_ = 0;
+		// Per parent in the next generation, the fitness of the genome it was copied from.
+		std::vector<float> parentFitnesses_{};
+		// The offspring that species s breeds from its own parents are nextGenomes_[offspringOffsets_[s], offspringOffsets_[s + 1]). Those after the last species come from two species.
+		std::vector<size_t> offspringOffsets_{};
+		// Per species, the sum of the selection weights of it and every species before it, so picking a species is a binary search (see buildSpeciesSelectionTable).
+		std::vector<double> speciesSelectionSums_{};
+		// The parents of each offspring (the more fit one first), as indices into nextGenomes_ and as the genomes themselves.
+		std::vector<std::pair<size_t, size_t>> parentPairs_{};
+		std::vector<std::pair<const Genome*, const Genome*>> parents_{};
+
+		// Per genome index, whether a thread is breeding or evaluating the genome (steady-state evolution only).
+		std::vector<uint8_t> beingEvaluated_{};
+		size_t steadyStateReplacements_ = 0;
+
+		/// <summary>
+		/// The bookkeeping of a species during steady-state evolution, kept up to date with every replacement instead of being rebuilt.
+		/// </summary>
+		struct SteadyStateSpecies
+		{
+			// The members that aren't being evaluated, which can be replaced or become parents: by fitness (least fit first), and in no particular order to pick parents from.
+			std::set<std::pair<float, size_t>> byFitness;
+			std::vector<size_t> available;
+			double fitnessSum = 0;
+			// Including the members that are being evaluated.
+			size_t memberCount = 0;
+			// What the species was last ranked with (see rankSteadyStateSpecies): whether it had available members, the adjusted fitness of its least fit one and its selection weight.
+			bool ranked = false;
+			float worstAdjustedFitness = 0;
+			double selectionWeight = 0;
+		};
+		std::vector<SteadyStateSpecies> steadyStateSpecies_{};
+		// Per genome index, its position in SteadyStateSpecies::available.
+		std::vector<size_t> availablePositions_{};
+		// The species with available members by the adjusted fitness of their least fit one, so the worst genome is found in O(log S).
+		std::set<std::pair<float, size_t>> speciesByWorstAdjustedFitness_{};
+		// Per species, its adjusted fitness sum (0 without available members), and 1 if it has available members, to pick a species to breed from in O(log S).
+		FenwickTree<double> steadyStateSelectionWeights_{};
+		FenwickTree<int64_t> breedableSpecies_{};
+		// Whether species_ and fitnesses_ belong to the current genomes, which is the case after steady-state evolution but not after a generation.
+		bool fitnessesCurrent_ = false;
+
+		// Scratch space that is kept between generations, so it doesn't have to be allocated again.
+		std::vector<Genome*> weightMutatedGenomes_{};
+		FlatHashMap<uint64_t, size_t> evaluatedByHash_{};
+
 		// Private methods
 		void computeAdjustedFitnessSums();
+		template<typename Weight, typename CanBreed>
+		void buildSpeciesSelectionTable(Weight weight, CanBreed canBreed);
+		void mutateGenomes(std::vector<Genome>& genomes, size_t begin, size_t end);
+		void createEvaluationTasks();
+		void evaluateGenomes(bool reproduceEarly);
+		[[nodiscard]] float combineChunkFitnesses(size_t genomeIndex) const;
+		void planSurvivors(std::mt19937& gen);
+		void selectSurvivors(size_t speciesIndex);
+		void breedSpecies(size_t speciesIndex);
+		void speciate();
+		void groupSpeciesMembers();
+		[[nodiscard]] size_t placeInSpecies(const Genome& genome);
+		void indexSpecies();
+		void addToSpeciesIndex(size_t speciesIndex);
+		/// <returns>The index of the first species in [speciesBegin, speciesEnd) the genome is compatible with, or noSpecies_c. </returns>
+		[[nodiscard]] size_t findCompatibleSpecies(const Genome& genome, size_t speciesBegin, size_t speciesEnd) const;
+		[[nodiscard]] bool isCompatible(const Species& species, const Genome& genome) const;
+		[[nodiscard]] size_t removeWorstGenome(std::mt19937& gen, Genome& parent1, Genome& parent2);
+		void makeAvailable(size_t genomeIndex);
+		void makeUnavailable(size_t genomeIndex);
+		void rankSteadyStateSpecies();
+		void rankSteadyStateSpecies(size_t speciesIndex);
+		[[nodiscard]] size_t getRandomSteadyStateSpecies(std::mt19937& gen) const;
 
-		[[nodiscard]] inline float getAdjustedFitness(Genome* genome) const { return fitnessMap_.at(genome) / speciesMap_.at(genome)->memberGenomes.size(); };
-		[[nodiscard]] const Species* getRandomSpeciesBiasedAdjustedFitness() const;
+		[[nodiscard]] inline float getAdjustedFitness(size_t genomeIndex) const { return fitnesses_[genomeIndex] / species_[speciesIds_[genomeIndex]].memberCount(); };
+		/// <returns>The index of the species in species_. </returns>
+		[[nodiscard]] size_t getRandomSpeciesBiasedAdjustedFitness(std::mt19937& gen) const;
 
 	protected:
 		std::vector<Genome> genomes_{};
-		std::unordered_map<Genome*, float> fitnessMap_{};
 
-		void calculateFitnessMap();
+		// The chances every offspring and survivor is mutated with (see Genome::mutate). Subclasses can change them, e.g. to keep the structure of the genomes fixed.
+		float mutateWeightChance_ = 0.8f;
+		float mutateAddNodeChance_ = 0.03f;
+		float mutateAddConnectionChance_ = 0.05f;
 
+		void calculateFitnesses();
+		// The fitness of genomes_[genomeIndex] from the last calculateFitnesses call.
+		[[nodiscard]] inline float genomeFitness(size_t genomeIndex) const { return fitnesses_[genomeIndex]; };
+
+		/// <summary>
+		/// Calculates the fitness of a genome. Called from several threads at once, each with a different genome, unless the evaluator only has one thread.
+		/// Implementations may read and change the genome they are given (e.g. evaluate it), and their own state that doesn't change during evolution (e.g. training data), but nothing else of the evaluator:
+		/// the other genomes, species and fitnesses are changed by other threads meanwhile (see evaluate_steadyState). Anything else the implementation shares between calls has to be synchronized by it.
+		/// </summary>
 		[[nodiscard]] virtual float evaluateGenomeTraining(Genome& genome) = 0;
+
+		/// <summary>
+		/// Subclasses whose fitness combines independent training samples can return the number of samples here, which allows the evaluation of a single expensive genome to be split over several threads.
+		/// The default of 0 never splits a genome.
+		/// </summary>
+		[[nodiscard]] virtual size_t trainingSampleCount() const { return 0; };
+		/// <summary>
+		/// Evaluates the genome on the training samples [begin, end). Only called if trainingSampleCount is more than 1, with the same thread safety rules as evaluateGenomeTraining.
+		/// The genome is a copy that only this call uses.
+		/// </summary>
+		[[nodiscard]] virtual float evaluateGenomeTrainingSamples(Genome& genome, size_t begin, size_t end);
+		/// <summary>
+		/// Combines the fitness of each chunk of training samples (in sample order) into the fitness of the genome. Sums them by default.
+		/// </summary>
+		[[nodiscard]] virtual float combineTrainingFitness(const std::vector<float>& chunkFitnesses) const;
 		[[nodiscard]] virtual FitnessCorrectpercentagePair evaluateGenomeTest(Genome& genome) = 0;
 	};
 
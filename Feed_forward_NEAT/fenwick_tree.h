@@ -0,0 +1,102 @@
+#ifndef FENWICK_TREE_H
+#define FENWICK_TREE_H
+
+#include <vector>
+#include <cassert>
+#include <cstddef>
+
+namespace neat
+{
+	/// <summary>
+	/// A binary indexed (Fenwick) tree over a sequence of non-negative weights: changing a weight, summing a prefix and finding the index a sum falls into all take O(log n).
+	/// Used to pick an index with probability proportional to its weight, while the weights keep changing.
+	/// </summary>
+	template<typename T>
+	class FenwickTree
+	{
+	public:
+		// Replaces the weights with the given ones, in O(n).
+		void assign(const std::vector<T>& weights)
+		{
+			tree_ = weights;
+			for (size_t i = 0; i < tree_.size(); i++)
+			{
+				const size_t parent = i | (i + 1);
+				if (parent < tree_.size())
+					tree_[parent] += tree_[i];
+			}
+		}
+
+		inline void clear() { tree_.clear(); };
+
+		// Appends a weight, in O(log n).
+		void push_back(const T& weight)
+		{
+			// The new entry covers the weights (i - lowestBit(i + 1), i], whose sum is taken before it is added.
+			const size_t i = tree_.size();
+			const size_t first = i + 1 - ((i + 1) & ~i);
+			tree_.push_back(weight + prefixSum(i) - prefixSum(first));
+		}
+
+		// Adds delta to the weight at index.
+		void add(size_t index, const T& delta)
+		{
+			for (size_t i = index; i < tree_.size(); i |= i + 1)
+				tree_[i] += delta;
+		}
+
+		// The sum of the first count weights.
+		[[nodiscard]] T prefixSum(size_t count) const
+		{
+			T sum{};
+			for (size_t i = count; i > 0; i &= i - 1)
+				sum += tree_[i - 1];
+			return sum;
+		}
+
+		[[nodiscard]] inline T total() const { return prefixSum(tree_.size()); };
+		[[nodiscard]] inline T weight(size_t index) const { return prefixSum(index + 1) - prefixSum(index); };
+		[[nodiscard]] inline size_t size() const { return tree_.size(); };
+
+		/// <summary>
+		/// Finds the index whose weight covers the given sum, the first index with prefixSum(index + 1) > sum. The sum has to be below total().
+		/// </summary>
+		/// <param name="remainder">Set to the part of the sum that falls into the index, sum - prefixSum(index).</param>
+		[[nodiscard]] size_t find(T sum, T& remainder) const
+		{
+			size_t step = 1;
+			while (step * 2 <= tree_.size())
+				step *= 2;
+
+			// Descends the implicit tree: pos is the number of weights known to sum to at most the sum.
+			size_t pos = 0;
+			for (; step > 0; step /= 2)
+			{
+				if (pos + step <= tree_.size() && !(sum < tree_[pos + step - 1]))
+				{
+					pos += step;
+					sum -= tree_[pos - 1];
+				}
+			}
+
+			// Rounding (for floating point weights) can leave the sum just past the end, which belongs to the last index with any weight.
+			if (pos == tree_.size())
+			{
+				assert(pos > 0 && "Can't find a sum in an empty tree!");
+				do
+					pos--;
+				while (pos > 0 && !(T{} < weight(pos)));
+				sum = T{};
+			}
+
+			remainder = sum;
+			return pos;
+		}
+
+	private:
+		// Entry i holds the sum of the weights (i - lowestBit(i + 1), i].
+		std::vector<T> tree_{};
+	};
+}
+
+#endif /* FENWICK_TREE_H */
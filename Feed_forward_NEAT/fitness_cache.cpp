@@ -0,0 +1,87 @@
+#include "fitness_cache.h"
+
+#include <iterator>
+
+
+namespace neat
+{
+
+	FitnessCache::FitnessCache(size_t capacity)
+		: capacity_(capacity)
+	{
+		entriesByHash_.reserve(capacity);
+	}
+
+	/// <summary>
+	/// Looks up the fitness of a genome identical to the given one.
+	/// </summary>
+	/// <returns>The fitness, or nothing if no identical genome is in the cache. </returns>
+	std::optional<float> FitnessCache::find(const Genome& genome)
+	{
+		if (capacity_ == 0)
+			return std::nullopt;
+
+		auto it = entriesByHash_.find(genome.hash());
+		if (it == entriesByHash_.end() || it->second->genome != genome)
+		{
+			missCount_++;
+			return std::nullopt;
+		}
+
+		// Mark the entry as the most recently used one.
+		entries_.splice(entries_.begin(), entries_, it->second);
+
+		hitCount_++;
+		return it->second->fitness;
+	}
+
+	/// <summary>
+	/// Remembers the fitness of a genome. If another genome with the same hash is cached, it is replaced.
+	/// </summary>
+	void FitnessCache::insert(const Genome& genome, float fitness)
+	{
+		if (capacity_ == 0)
+			return;
+
+		const uint64_t hash = genome.hash();
+
+		auto it = entriesByHash_.find(hash);
+		if (it != entriesByHash_.end())
+		{
+			assign(*it->second, hash, genome, fitness);
+			entries_.splice(entries_.begin(), entries_, it->second);
+			return;
+		}
+
+		// Forget the least recently used genome. Its entry is reused for the new genome, so a full cache doesn't allocate anymore.
+		if (entries_.size() >= capacity_)
+		{
+			entriesByHash_.erase(entries_.back().hash);
+			entries_.splice(entries_.begin(), entries_, std::prev(entries_.end()));
+			assign(entries_.front(), hash, genome, fitness);
+		}
+		else
+		{
+			entries_.push_front({ hash, genome, fitness });
+		}
+
+		entriesByHash_.emplace(hash, entries_.begin());
+	}
+
+	/// <summary>
+	/// Overwrites an entry. The genome is assigned in place, so it keeps its memory.
+	/// </summary>
+	void FitnessCache::assign(Entry& entry, uint64_t hash, const Genome& genome, float fitness)
+	{
+		entry.hash = hash;
+		entry.genome = genome;
+		entry.fitness = fitness;
+	}
+
+	void FitnessCache::clear()
+	{
+		entries_.clear();
+		entriesByHash_.clear();
+	}
+
+}
@@ -0,0 +1,59 @@
+#ifndef FITNESS_CACHE_H
+#define FITNESS_CACHE_H
+
+#include "NEAT.h"
+#include "flat_hash_map.h"
+
+#include <list>
+#include <optional>
+#include <cstdint>
+
+namespace neat
+{
+	/// <summary>
+	/// Remembers the fitness of recently evaluated genomes, so identical genomes (elites, copies whose mutations didn't change anything) don't have to be evaluated again.
+	/// Genomes are looked up by their hash, and compared exactly, so a hash collision can never return the wrong fitness. 
+	/// Once full, the least recently used genome is forgotten. Only valid as long as the fitness of a genome never changes.
+	/// </summary>
+	class FitnessCache
+	{
+	public:
+		// A capacity of 0 disables the cache.
+		explicit FitnessCache(size_t capacity);
+
+		// Public methods
+		[[nodiscard]] std::optional<float> find(const Genome& genome);
+		void insert(const Genome& genome, float fitness);
+		void clear();
+
+		// Getters
+		[[nodiscard]] inline size_t size() const { return entries_.size(); };
+		[[nodiscard]] inline size_t capacity() const { return capacity_; };
+		[[nodiscard]] inline uint64_t hitCount() const { return hitCount_; };
+		[[nodiscard]] inline uint64_t missCount() const { return missCount_; };
+
+	private:
+		struct Entry
+		{
+			uint64_t hash;
+			// A copy of the genome. Copies share the topology, so this is mostly the weights.
+			Genome genome;
+			float fitness;
+		};
+
+		const size_t capacity_;
+
+		// Ordered from most to least recently used.
+		std::list<Entry> entries_{};
+		FlatHashMap<uint64_t, std::list<Entry>::iterator> entriesByHash_{};
+
+		uint64_t hitCount_ = 0;
+		uint64_t missCount_ = 0;
+
+		// Private methods
+		static void assign(Entry& entry, uint64_t hash, const Genome& genome, float fitness);
+	};
+
+}
+
+#endif /* FITNESS_CACHE_H */
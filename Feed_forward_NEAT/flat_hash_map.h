@@ -0,0 +1,306 @@
+#ifndef FLAT_HASH_MAP_H
+#define FLAT_HASH_MAP_H
+
+#include <vector>
+#include <algorithm>
+#include <utility>
+#include <iterator>
+#include <type_traits>
+#include <cassert>
+#include <cstdint>
+#include <cstddef>
+
+namespace neat
+{
+	/// <summary>
+	/// Scrambles every bit of value into every bit of the result (the SplitMix64 finalizer).
+	/// Keys like node ids and pointers only differ in a few low bits, which this spreads across the whole hash.
+	/// </summary>
+	[[nodiscard]] inline uint64_t mixHash(uint64_t value)
+	{
+		value ^= value >> 30;
+		value *= 0xbf58476d1ce4e5b9ULL;
+		value ^= value >> 27;
+		value *= 0x94d049bb133111ebULL;
+		value ^= value >> 31;
+		return value;
+	}
+
+	/// <summary>
+	/// Hash for integer and pointer keys.
+	/// </summary>
+	template<typename Key>
+	struct IntegerHash
+	{
+		inline uint64_t operator()(Key key) const
+		{
+			if constexpr (std::is_pointer_v<Key>)
+				return mixHash(static_cast<uint64_t>(reinterpret_cast<uintptr_t>(key)));
+			else
+				return mixHash(static_cast<uint64_t>(key));
+		}
+	};
+
+	/// <summary>
+	/// Open addressing hash map with linear probing, for small keys (integers, pointers, pairs of integers) that are cheap to compare.
+	/// Entries are stored in a single array, so a lookup usually touches one cache line instead of following a bucket list like std::unordered_map.
+	/// Removal shifts the following entries back, so there are no tombstones, and lookups never slow down after many removals.
+	/// Both Key and Value have to be default constructible. Any insertion or removal invalidates iterators and references.
+	/// </summary>
+	template<typename Key, typename Value, typename Hash = IntegerHash<Key>>
+	class FlatHashMap
+	{
+	public:
+		using value_type = std::pair<Key, Value>;
+
+		template<bool isConst>
+		class Iterator
+		{
+		public:
+			using iterator_category = std::forward_iterator_tag;
+			using value_type = FlatHashMap::value_type;
+			using difference_type = std::ptrdiff_t;
+			using pointer = std::conditional_t<isConst, const value_type*, value_type*>;
+			using reference = std::conditional_t<isConst, const value_type&, value_type&>;
+			using MapPointer = std::conditional_t<isConst, const FlatHashMap*, FlatHashMap*>;
+
+			Iterator(MapPointer map, size_t index) : map_(map), index_(index) { skipEmptySlots(); };
+			// Allows converting an iterator to a const iterator.
+			Iterator(const Iterator<false>& other) : map_(other.map_), index_(other.index_) {};
+
+			[[nodiscard]] inline reference operator*() const { return map_->slots_[index_]; };
+			[[nodiscard]] inline pointer operator->() const { return &map_->slots_[index_]; };
+
+			inline Iterator& operator++() { index_++; skipEmptySlots(); return *this; };
+			inline Iterator operator++(int) { Iterator copy = *this; ++*this; return copy; };
+
+			[[nodiscard]] inline bool operator==(const Iterator& other) const { return index_ == other.index_; };
+			[[nodiscard]] inline bool operator!=(const Iterator& other) const { return index_ != other.index_; };
+
+		private:
+			friend class FlatHashMap;
+			template<bool> friend class Iterator;
+
+			MapPointer map_;
+			size_t index_;
+
+			inline void skipEmptySlots()
+			{
+				while (index_ < map_->slots_.size() && !map_->occupied_[index_])
+					index_++;
+			}
+		};
+
+		using iterator = Iterator<false>;
+		using const_iterator = Iterator<true>;
+
+		FlatHashMap() = default;
+
+		// Public methods
+		[[nodiscard]] inline iterator begin() { return iterator(this, 0); };
+		[[nodiscard]] inline iterator end() { return iterator(this, slots_.size()); };
+		[[nodiscard]] inline const_iterator begin() const { return const_iterator(this, 0); };
+		[[nodiscard]] inline const_iterator end() const { return const_iterator(this, slots_.size()); };
+
+		[[nodiscard]] inline iterator find(const Key& key) { return iterator(this, findIndex(key)); };
+		[[nodiscard]] inline const_iterator find(const Key& key) const { return const_iterator(this, findIndex(key)); };
+		[[nodiscard]] inline bool contains(const Key& key) const { return findIndex(key) != slots_.size(); };
+
+		[[nodiscard]] inline Value& at(const Key& key)
+		{
+			const size_t index = findIndex(key);
+			assert(index != slots_.size() && "Key is not in the map!");
+			return slots_[index].second;
+		}
+
+		[[nodiscard]] inline const Value& at(const Key& key) const
+		{
+			const size_t index = findIndex(key);
+			assert(index != slots_.size() && "Key is not in the map!");
+			return slots_[index].second;
+		}
+
+		inline Value& operator[](const Key& key) { return try_emplace(key).first->second; };
+
+		/// <summary>
+		/// Inserts the key with a value constructed from args, unless the key is already in the map.
+		/// </summary>
+		/// <returns>An iterator to the entry with the key, and whether it was inserted. </returns>
+		template<typename... Args>
+		std::pair<iterator, bool> try_emplace(const Key& key, Args&&... args)
+		{
+			const size_t existingIndex = findIndex(key);
+			if (existingIndex != slots_.size())
+				return { iterator(this, existingIndex), false };
+
+			if ((size_ + 1) * maxLoadDenominator_c > slots_.size() * maxLoadNumerator_c)
+				rehash(std::max<size_t>(minCapacity_c, slots_.size() * 2));
+
+			size_t index = Hash()(key) & mask_;
+			while (occupied_[index])
+				index = (index + 1) & mask_;
+
+			slots_[index] = value_type(key, Value(std::forward<Args>(args)...));
+			occupied_[index] = 1;
+			size_++;
+
+			return { iterator(this, index), true };
+		}
+
+		inline std::pair<iterator, bool> emplace(const Key& key, Value value) { return try_emplace(key, std::move(value)); };
+
+		/// <summary>
+		/// Removes the key from the map.
+		/// </summary>
+		/// <returns>The number of removed entries (0 or 1). </returns>
+		size_t erase(const Key& key)
+		{
+			const size_t index = findIndex(key);
+			if (index == slots_.size())
+				return 0;
+
+			eraseAt(index);
+			return 1;
+		}
+
+		/// <summary>
+		/// Removes every entry for which predicate returns true, in place (erasing entries while iterating isn't allowed).
+		/// </summary>
+		template<typename Predicate>
+		void eraseIf(Predicate predicate)
+		{
+			if (size_ == 0)
+				return;
+
+			// Removing an entry only moves entries of the same probe sequence back, towards the removed one. Starting right after an empty slot (the map is never full),
+			// every probe sequence is visited from its start, so entries only ever move onto the slot being visited or ones that haven't been visited yet.
+			size_t start = 0;
+			while (occupied_[start])
+				start++;
+
+			for (size_t visited = 1, index = (start + 1) & mask_; visited < slots_.size(); )
+			{
+				// An entry that moves onto this slot hasn't been checked yet, so the slot is checked again.
+				if (occupied_[index] && predicate(slots_[index]))
+				{
+					eraseAt(index);
+					continue;
+				}
+
+				visited++;
+				index = (index + 1) & mask_;
+			}
+		}
+
+		/// <summary>
+		/// Removes every entry, but keeps the memory.
+		/// </summary>
+		void clear()
+		{
+			if (size_ == 0)
+				return;
+
+			for (size_t i = 0; i < slots_.size(); i++)
+			{
+				if (occupied_[i])
+					slots_[i] = value_type();
+			}
+			std::fill(occupied_.begin(), occupied_.end(), 0);
+			size_ = 0;
+		}
+
+		/// <summary>
+		/// Makes room for count entries without growing again.
+		/// </summary>
+		void reserve(size_t count)
+		{
+			size_t capacity = minCapacity_c;
+			while (count * maxLoadDenominator_c > capacity * maxLoadNumerator_c)
+				capacity *= 2;
+
+			if (capacity > slots_.size())
+				rehash(capacity);
+		}
+
+		// Getters
+		[[nodiscard]] inline size_t size() const { return size_; };
+		[[nodiscard]] inline bool empty() const { return size_ == 0; };
+		[[nodiscard]] inline size_t capacity() const { return slots_.size(); };
+
+	private:
+		// The map grows once it is 3/4 full. Linear probing gets slow quickly above that.
+		static constexpr size_t maxLoadNumerator_c = 3;
+		static constexpr size_t maxLoadDenominator_c = 4;
+		static constexpr size_t minCapacity_c = 16;
+
+		std::vector<value_type> slots_{};
+		std::vector<uint8_t> occupied_{};
+		size_t size_ = 0;
+		// The capacity is always a power of two, so the slot of a hash is hash & mask_.
+		size_t mask_ = 0;
+
+		// Private methods
+		/// <returns>The slot of the key, or the capacity if the key isn't in the map. </returns>
+		[[nodiscard]] size_t findIndex(const Key& key) const
+		{
+			if (size_ == 0)
+				return slots_.size();
+
+			for (size_t index = Hash()(key) & mask_; occupied_[index]; index = (index + 1) & mask_)
+			{
+				if (slots_[index].first == key)
+					return index;
+			}
+
+			return slots_.size();
+		}
+
+		/// <summary>
+		/// Removes the entry in the slot, and moves back every following entry of the probe sequence that would otherwise no longer be found.
+		/// </summary>
+		void eraseAt(size_t hole)
+		{
+			for (size_t next = (hole + 1) & mask_; occupied_[next]; next = (next + 1) & mask_)
+			{
+				const size_t ideal = Hash()(slots_[next].first) & mask_;
+				if (((next - ideal) & mask_) >= ((next - hole) & mask_))
+				{
+					slots_[hole] = std::move(slots_[next]);
+					hole = next;
+				}
+			}
+
+			slots_[hole] = value_type();
+			occupied_[hole] = 0;
+			size_--;
+		}
+
+		void rehash(size_t capacity)
+		{
+			assert((capacity & (capacity - 1)) == 0 && "Capacity has to be a power of two!");
+			assert(capacity * maxLoadNumerator_c >= size_ * maxLoadDenominator_c && "Capacity is too small for the entries!");
+
+			std::vector<value_type> oldSlots(capacity);
+			std::vector<uint8_t> oldOccupied(capacity, 0);
+			oldSlots.swap(slots_);
+			oldOccupied.swap(occupied_);
+			mask_ = capacity - 1;
+
+			for (size_t i = 0; i < oldSlots.size(); i++)
+			{
+				if (!oldOccupied[i])
+					continue;
+
+				size_t index = Hash()(oldSlots[i].first) & mask_;
+				while (occupied_[index])
+					index = (index + 1) & mask_;
+
+				slots_[index] = std::move(oldSlots[i]);
+				occupied_[index] = 1;
+			}
+		}
+	};
+
+}
+
+#endif /* FLAT_HASH_MAP_H */
@@ -0,0 +1,36 @@
+#ifndef FUNCTION_REF_H
+#define FUNCTION_REF_H
+
+#include <memory>
+#include <type_traits>
+#include <utility>
+
+namespace neat
+{
+	template<typename Signature>
+	class FunctionRef;
+
+	/// <summary>
+	/// A reference to a callable, for functions that only call it before they return. Unlike std::function it never copies the callable, so passing a lambda with many captures doesn't allocate.
+	/// The callable has to outlive the reference, which a temporary passed as an argument does.
+	/// </summary>
+	template<typename Result, typename... Args>
+	class FunctionRef<Result(Args...)>
+	{
+	public:
+		template<typename Function, typename = std::enable_if_t<!std::is_same_v<std::decay_t<Function>, FunctionRef>>>
+		FunctionRef(Function&& function)
+			: callable_(const_cast<void*>(static_cast<const void*>(std::addressof(function)))),
+			call_([](void* callable, Args... args) -> Result { return (*static_cast<std::remove_reference_t<Function>*>(callable))(std::forward<Args>(args)...); })
+		{
+		}
+
+		inline Result operator()(Args... args) const { return call_(callable_, std::forward<Args>(args)...); };
+
+	private:
+		void* callable_;
+		Result(*call_)(void*, Args...);
+	};
+}
+
+#endif /* FUNCTION_REF_H */
@@ -0,0 +1,120 @@
+#include "innovation_registry.h"
+
+#include <cassert>
+
+
+namespace neat
+{
+
+	InnovationRegistry::InnovationRegistry(uint64_t generationsToKeep)
+		: generationsToKeep_(generationsToKeep)
+	{
+		assert(generationsToKeep > 0 && "The registry must at least remember the current generation!");
+	}
+
+	uint64_t InnovationRegistry::getInnovationNumber(uint64_t inNode, uint64_t outNode)
+	{
+		const std::pair<uint64_t, uint64_t> connection{ inNode, outNode };
+		auto& shard = getShard(connection);
+
+		// The shard stays locked until the innovation is stored, so two threads can't assign different numbers to the same connection.
+		std::lock_guard<std::mutex> lock(shard.mutex);
+
+		auto it = shard.innovations.find(connection);
+		if (it != shard.innovations.end())
+		{
+			it->second.lastSeenGeneration = generation_;
+			return it->second.innovationNumber;
+		}
+
+		// The count never goes past the limit, so innovationCount() stays a count of numbers that were actually handed out.
+		uint64_t innovationNumber = nextInnovationNumber_;
+		do
+		{
+			if (innovationNumber >= maxInnovationCount_c)
+				return noInnovation_c;
+		} while (!nextInnovationNumber_.compare_exchange_weak(innovationNumber, innovationNumber + 1));
+
+		shard.innovations.emplace(connection, Innovation{ innovationNumber, generation_ });
+
+		return innovationNumber;
+	}
+
+	uint64_t InnovationRegistry::getSplitNodeId(uint64_t connectionInnovationNumber)
+	{
+		auto& shard = getShard(connectionInnovationNumber);
+		std::lock_guard<std::mutex> lock(shard.mutex);
+
+		auto it = shard.splitNodes.find(connectionInnovationNumber);
+		if (it != shard.splitNodes.end())
+		{
+			it->second.lastSeenGeneration = generation_;
+			return it->second.nodeId;
+		}
+
+		const uint64_t nodeId = nextNodeId_++;
+		shard.splitNodes.emplace(connectionInnovationNumber, SplitNode{ nodeId, generation_ });
+
+		return nodeId;
+	}
+
+	void InnovationRegistry::nextGeneration()
+	{
+		const uint64_t generation = ++generation_;
+
+		for (auto& shard : shards_)
+		{
+			std::lock_guard<std::mutex> lock(shard.mutex);
+
+			shard.innovations.eraseIf([&](const auto& innovation)
+				{
+					return generation - innovation.second.lastSeenGeneration >= generationsToKeep_;
+				});
+			shard.splitNodes.eraseIf([&](const auto& splitNode)
+				{
+					return generation - splitNode.second.lastSeenGeneration >= generationsToKeep_;
+				});
+		}
+	}
+
+	void InnovationRegistry::clear()
+	{
+		for (auto& shard : shards_)
+		{
+			std::lock_guard<std::mutex> lock(shard.mutex);
+			shard.innovations.clear();
+			shard.splitNodes.clear();
+		}
+	}
+
+	void InnovationRegistry::reserveInnovationNumbers(uint64_t innovationCount)
+	{
+		assert(innovationCount <= maxInnovationCount_c && "Innovation numbers past maxInnovationCount_c don't fit in a connection gene!");
+
+		uint64_t current = nextInnovationNumber_;
+		while (current < innovationCount && !nextInnovationNumber_.compare_exchange_weak(current, innovationCount))
+		{
+		}
+	}
+
+	void InnovationRegistry::reserveNodeIds(uint64_t nextNodeId)
+	{
+		uint64_t current = nextNodeId_;
+		while (current < nextNodeId && !nextNodeId_.compare_exchange_weak(current, nextNodeId))
+		{
+		}
+	}
+
+	size_t InnovationRegistry::rememberedInnovationCount() const
+	{
+		size_t count = 0;
+		for (const auto& shard : shards_)
+		{
+			std::lock_guard<std::mutex> lock(shard.mutex);
+			count += shard.innovations.size();
+		}
+
+		return count;
+	}
+
+}
@@ -0,0 +1,127 @@
+#ifndef INNOVATION_REGISTRY_H
+#define INNOVATION_REGISTRY_H
+
+#include "flat_hash_map.h"
+
+#include <array>
+#include <atomic>
+#include <mutex>
+#include <cstdint>
+
+struct hashPair
+{
+	// The first value is mixed on its own before the second is added, so (a, b) and (b, a) don't collide, and neither do all (x, x) pairs.
+	inline uint64_t operator()(const std::pair<uint64_t, uint64_t>& pair) const
+	{
+		return neat::mixHash(neat::mixHash(pair.first) + pair.second);
+	}
+};
+
+namespace neat
+{
+	/// <summary>
+	/// Hands out innovation numbers for new connections and ids for new hidden nodes, such that identical structural mutations get the same innovation numbers and node ids.
+	/// Connections are identified by the ids of their nodes (not by their indices within a genome, which differ between genomes), and new nodes by the connection they split.
+	/// The registry is sharded, so any number of threads can mutate genomes at the same time.
+	/// Innovations are forgotten after they haven't been seen for a number of generations (by default, only the current generation is remembered).
+	/// </summary>
+	class InnovationRegistry
+	{
+	public:
+		explicit InnovationRegistry(uint64_t generationsToKeep = 1);
+
+		InnovationRegistry(const InnovationRegistry&) = delete;
+		InnovationRegistry& operator=(const InnovationRegistry&) = delete;
+
+		// Public methods
+		/// <summary>
+		/// Gets the innovation number of the connection from the node with id inNode to the node with id outNode. 
+		/// If the connection hasn't been seen within the remembered generations, a new innovation number is assigned to it.
+		/// </summary>
+		/// <returns>The innovation number, or noInnovation_c if the connection is new and all maxInnovationCount_c innovation numbers have been handed out. </returns>
+		[[nodiscard]] uint64_t getInnovationNumber(uint64_t inNode, uint64_t outNode);
+
+		/// <summary>
+		/// Gets the id of the node that splits the connection with the given innovation number.
+		/// If that split hasn't been seen within the remembered generations, a new node id is assigned to it.
+		/// </summary>
+		[[nodiscard]] uint64_t getSplitNodeId(uint64_t connectionInnovationNumber);
+
+		/// <summary>
+		/// Gets a node id that has never been handed out before, for nodes that don't split a connection.
+		/// </summary>
+		[[nodiscard]] inline uint64_t newNodeId() { return nextNodeId_++; };
+
+		/// <summary>
+		/// Ages the registry by one generation, forgetting any innovations that haven't been seen within the remembered generations.
+		/// Should not be called while other threads are getting innovation numbers.
+		/// </summary>
+		void nextGeneration();
+
+		/// <summary>
+		/// Forgets every innovation. Innovation numbers keep counting up from where they were.
+		/// </summary>
+		void clear();
+
+		/// <summary>
+		/// Makes sure that innovation numbers below innovationCount are never handed out again (e.g. after loading genomes that already use them).
+		/// </summary>
+		void reserveInnovationNumbers(uint64_t innovationCount);
+
+		/// <summary>
+		/// Makes sure that node ids below nextNodeId are never handed out again.
+		/// </summary>
+		void reserveNodeIds(uint64_t nextNodeId);
+
+		// Input, bias and output nodes use their index as their id, so hidden node ids start far above any index.
+		static constexpr uint64_t firstNodeId_c = uint64_t{ 1 } << 32;
+		// Connection genes store innovation numbers in 31 bits (next to their expressed flag), so no more than this many are handed out.
+		static constexpr uint64_t maxInnovationCount_c = uint64_t{ 1 } << 31;
+		static constexpr uint64_t noInnovation_c = UINT64_MAX;
+
+		// Getters
+		[[nodiscard]] inline uint64_t generation() const { return generation_; };
+		[[nodiscard]] inline uint64_t innovationCount() const { return nextInnovationNumber_; };
+		[[nodiscard]] inline uint64_t nextNodeId() const { return nextNodeId_; };
+		[[nodiscard]] size_t rememberedInnovationCount() const;
+
+	private:
+		struct Innovation
+		{
+			uint64_t innovationNumber;
+			uint64_t lastSeenGeneration;
+		};
+
+		struct SplitNode
+		{
+			uint64_t nodeId;
+			uint64_t lastSeenGeneration;
+		};
+
+		struct Shard
+		{
+			mutable std::mutex mutex;
+			FlatHashMap<std::pair<uint64_t, uint64_t>, Innovation, hashPair> innovations{};
+			// By the innovation number of the connection that was split.
+			FlatHashMap<uint64_t, SplitNode> splitNodes{};
+		};
+
+		static constexpr size_t shardCount_c = 16;
+
+		const uint64_t generationsToKeep_;
+
+		std::atomic<uint64_t> nextInnovationNumber_ = 0;
+		std::atomic<uint64_t> nextNodeId_ = firstNodeId_c;
+		std::atomic<uint64_t> generation_ = 0;
+
+		std::array<Shard, shardCount_c> shards_{};
+
+		// Private methods
+		// The shard is picked with the upper half of the hash, since the maps inside the shards use the lowest bits.
+		[[nodiscard]] inline Shard& getShard(const std::pair<uint64_t, uint64_t>& connection) { return shards_[(hashPair()(connection) >> 32) % shardCount_c]; };
+		[[nodiscard]] inline Shard& getShard(uint64_t connectionInnovationNumber) { return shards_[(mixHash(connectionInnovationNumber) >> 32) % shardCount_c]; };
+	};
+
+}
+
+#endif /* INNOVATION_REGISTRY_H */
@@ -0,0 +1,333 @@
+#include "population_file.h"
+
+#include <fstream>
+#include <iostream>
+#include <cstring>
+#include <cassert>
+#include <algorithm>
+#include <type_traits>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace neat
+{
+	static_assert(std::is_trivially_copyable_v<Genome::Topology::Connection>, "Connections must be trivially copyable to be read in place!");
+	static_assert((sizeof(Genome::Topology::Connection) + sizeof(float)) % 8 == 0, "A connection and its weight must keep the following arrays 8-byte aligned!");
+
+	PopulationFile::PopulationFile(const std::string& fileName)
+	{
+#ifdef _WIN32
+		HANDLE file = CreateFileA(fileName.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+		if (file == INVALID_HANDLE_VALUE)
+		{
+			std::cerr << "Failed to open file (in population_file.cpp): " << fileName << '\n';
+			return;
+		}
+		fileHandle_ = file;
+
+		LARGE_INTEGER fileSize;
+		if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0)
+			return;
+		size_ = static_cast<size_t>(fileSize.QuadPart);
+
+		HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		if (mapping == nullptr)
+			return;
+		mappingHandle_ = mapping;
+
+		data_ = static_cast<const unsigned char*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+		if (data_ == nullptr)
+			return;
+#else
+		fileDescriptor_ = open(fileName.c_str(), O_RDONLY);
+		if (fileDescriptor_ < 0)
+		{
+			std::cerr << "Failed to open file (in population_file.cpp): " << fileName << '\n';
+			return;
+		}
+
+		struct stat fileStats;
+		if (fstat(fileDescriptor_, &fileStats) != 0 || fileStats.st_size == 0)
+			return;
+		size_ = static_cast<size_t>(fileStats.st_size);
+
+		void* mapped = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fileDescriptor_, 0);
+		if (mapped == MAP_FAILED)
+			return;
+		data_ = static_cast<const unsigned char*>(mapped);
+#endif
+
+		if (!validateHeader())
+		{
+			std::cerr << "Invalid population file (in population_file.cpp): " << fileName << '\n';
+			return;
+		}
+
+		header_ = reinterpret_cast<const FileHeader*>(data_);
+		records_ = reinterpret_cast<const GenomeRecord*>(data_ + sizeof(FileHeader));
+	}
+
+	PopulationFile::~PopulationFile()
+	{
+#ifdef _WIN32
+		if (data_ != nullptr)
+			UnmapViewOfFile(data_);
+		if (mappingHandle_ != nullptr)
+			CloseHandle(mappingHandle_);
+		if (fileHandle_ != nullptr)
+			CloseHandle(fileHandle_);
+#else
+		if (data_ != nullptr)
+			munmap(const_cast<unsigned char*>(data_), size_);
+		if (fileDescriptor_ >= 0)
+			close(fileDescriptor_);
+#endif
+	}
+
+	std::optional<Genome> PopulationFile::loadGenome(size_t index) const
+	{
+		assert(isValid() && "Tried loading a genome from an invalid population file!");
+		assert(index < genomeCount() && "Tried loading a genome that doesn't exist!");
+
+		if (!validateGenome(index))
+			return std::nullopt;
+
+		reserveIds();
+		return constructGenome(index);
+	}
+
+	bool PopulationFile::loadPopulation(std::vector<Genome>& population) const
+	{
+		assert(isValid() && "Tried loading a population from an invalid population file!");
+
+		for (size_t i = 0; i < genomeCount(); i++)
+		{
+			if (!validateGenome(i))
+				return false;
+		}
+
+		population.clear();
+		population.reserve(genomeCount());
+		for (size_t i = 0; i < genomeCount(); i++)
+			population.push_back(constructGenome(i));
+
+		reserveIds();
+
+		return true;
+	}
+
+	bool PopulationFile::write(const std::string& fileName, const Genome& genome)
+	{
+		const Genome* genomes[] = { &genome };
+		return write(fileName, genomes, 1, Kind::GENOME);
+	}
+
+	bool PopulationFile::write(const std::string& fileName, const std::vector<Genome>& population)
+	{
+		std::vector<const Genome*> genomes;
+		genomes.reserve(population.size());
+		for (const auto& genome : population)
+			genomes.push_back(&genome);
+
+		return write(fileName, genomes.data(), genomes.size(), Kind::POPULATION);
+	}
+
+	bool PopulationFile::write(const std::string& fileName, const Genome* const* genomes, size_t genomeCount, Kind kind)
+	{
+		std::ofstream outFile{ fileName, std::ios::binary };
+		if (!outFile.is_open())
+		{
+			std::cerr << "Failed to open file (in population_file.cpp): " << fileName << '\n';
+			return false;
+		}
+
+		// Build the header and the genome table.
+		FileHeader header{};
+		std::memcpy(header.magic, magic_c, sizeof(magic_c));
+		header.byteOrderMark = byteOrderMark_c;
+		header.version = version_c;
+		header.kind = static_cast<uint32_t>(kind);
+		header.genomeCount = genomeCount;
+		header.innovationCount = 0;
+		header.nextNodeId = InnovationRegistry::firstNodeId_c;
+
+		std::vector<GenomeRecord> records(genomeCount);
+		uint64_t offset = sizeof(FileHeader) + genomeCount * sizeof(GenomeRecord);
+		for (size_t i = 0; i < genomeCount; i++)
+		{
+			const Genome& genome = *genomes[i];
+			const auto& topology = genome.topology();
+			records[i] = { genome.inputCount_, genome.outputCount_, topology.nodeGenes().size(), topology.connections().size(), offset };
+			offset += genomeLayout(topology.nodeGenes().size(), topology.connections().size()).size;
+
+			// Connections are sorted, so the last one has the largest innovation number.
+			if (!topology.connections().empty())
+				header.innovationCount = std::max<uint64_t>(header.innovationCount, topology.connections().back().innovationNumber + 1ULL);
+			for (uint64_t nodeId : topology.nodeIds())
+				header.nextNodeId = std::max<uint64_t>(header.nextNodeId, nodeId + 1);
+		}
+
+		outFile.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		outFile.write(reinterpret_cast<const char*>(records.data()), records.size() * sizeof(GenomeRecord));
+
+		// Write the genome data, every array as it is in memory.
+		const auto writeArray = [&outFile](const auto* data, size_t count) { outFile.write(reinterpret_cast<const char*>(data), count * sizeof(*data)); };
+		for (size_t i = 0; i < genomeCount; i++)
+		{
+			const Genome& genome = *genomes[i];
+			const auto& topology = genome.topology();
+
+			writeArray(topology.connections().data(), topology.connections().size());
+			writeArray(genome.weights().data(), genome.weights().size());
+			writeArray(genome.values().expressed.data(), genome.values().expressed.size());
+			writeArray(topology.topologicalOrder().data(), topology.topologicalOrder().size());
+			writeArray(topology.nodeIds().data(), topology.nodeIds().size());
+		}
+
+		return outFile.good();
+	}
+
+	bool PopulationFile::validateHeader() const
+	{
+		if (data_ == nullptr || size_ < sizeof(FileHeader))
+			return false;
+
+		const auto* header = reinterpret_cast<const FileHeader*>(data_);
+		if (std::memcmp(header->magic, magic_c, sizeof(magic_c)) != 0)
+			return false;
+		if (header->byteOrderMark != byteOrderMark_c)
+			return false;
+		if (header->version != version_c)
+			return false;
+		if (header->kind != static_cast<uint32_t>(Kind::GENOME) && header->kind != static_cast<uint32_t>(Kind::POPULATION))
+			return false;
+		if (header->kind == static_cast<uint32_t>(Kind::GENOME) && header->genomeCount != 1)
+			return false;
+		// Connection genes can't hold larger innovation numbers.
+		if (header->innovationCount > InnovationRegistry::maxInnovationCount_c)
+			return false;
+
+		// The genome table must fit in the file.
+		if (header->genomeCount > (size_ - sizeof(FileHeader)) / sizeof(GenomeRecord))
+			return false;
+
+		// Every genome's data must fit in the file, and be aligned.
+		const auto* records = reinterpret_cast<const GenomeRecord*>(data_ + sizeof(FileHeader));
+		for (uint64_t i = 0; i < header->genomeCount; i++)
+		{
+			const auto& record = records[i];
+
+			// Guards against overflow in the size calculation below.
+			if (record.nodeCount > size_ || record.connectionCount > size_)
+				return false;
+			if (record.dataOffset % 8 != 0 || record.dataOffset > size_)
+				return false;
+			if (genomeLayout(record.nodeCount, record.connectionCount).size > size_ - record.dataOffset)
+				return false;
+		}
+
+		return true;
+	}
+
+	bool PopulationFile::validateGenome(size_t index) const
+	{
+		const auto& record = records_[index];
+
+		// There must be room for the inputs, the bias node and the outputs (checked without adding the counts, which could overflow), and every node index must fit in a connection.
+		if (record.inputCount == 0 || record.outputCount == 0)
+			return false;
+		if (record.inputCount >= record.nodeCount || record.outputCount >= record.nodeCount - record.inputCount)
+			return false;
+		if (record.nodeCount > UINT32_MAX)
+			return false;
+
+		const auto layout = genomeLayout(record.nodeCount, record.connectionCount);
+		const auto* connections = reinterpret_cast<const Genome::Topology::Connection*>(data_ + record.dataOffset);
+		const auto* expressed = reinterpret_cast<const uint64_t*>(data_ + record.dataOffset + layout.expressedOffset);
+		const auto* topologicalOrder = reinterpret_cast<const uint64_t*>(data_ + record.dataOffset + layout.topologicalOrderOffset);
+		const auto* nodeIds = reinterpret_cast<const uint64_t*>(data_ + record.dataOffset + layout.nodeIdsOffset);
+
+		// The expressed flags past the last connection must be 0, like they are in memory.
+		if (record.connectionCount % 64 != 0 && (expressed[record.connectionCount / 64] >> (record.connectionCount % 64)) != 0)
+			return false;
+
+		// The topological order must be a permutation of the nodes.
+		std::vector<uint32_t> nodeOrder(record.nodeCount, UINT32_MAX);
+		for (uint32_t i = 0; i < record.nodeCount; i++)
+		{
+			if (topologicalOrder[i] >= record.nodeCount || nodeOrder[topologicalOrder[i]] != UINT32_MAX)
+				return false;
+			nodeOrder[topologicalOrder[i]] = i;
+		}
+
+		// Input, bias and output nodes use their index as their id. Hidden nodes must have ids from the registry, and no two nodes can have the same id.
+		const uint64_t hiddenBegin = record.inputCount + 1 + record.outputCount;
+		for (uint64_t i = 0; i < hiddenBegin; i++)
+		{
+			if (nodeIds[i] != i)
+				return false;
+		}
+
+		std::vector<uint64_t> hiddenNodeIds(nodeIds + hiddenBegin, nodeIds + record.nodeCount);
+		std::sort(hiddenNodeIds.begin(), hiddenNodeIds.end());
+		if (std::adjacent_find(hiddenNodeIds.begin(), hiddenNodeIds.end()) != hiddenNodeIds.end())
+			return false;
+		if (!hiddenNodeIds.empty() && (hiddenNodeIds.front() < InnovationRegistry::firstNodeId_c || hiddenNodeIds.back() >= header_->nextNodeId))
+			return false;
+
+		for (uint64_t i = 0; i < record.connectionCount; i++)
+		{
+			const auto& connection = connections[i];
+
+			// Connections must go between existing nodes, out of an input or hidden node and into an output or hidden node.
+			if (connection.inNode >= record.nodeCount || connection.outNode >= record.nodeCount)
+				return false;
+			if (connection.inNode > record.inputCount && connection.inNode < hiddenBegin)
+				return false;
+			if (connection.outNode <= record.inputCount)
+				return false;
+
+			// The order must agree with every connection (which also guarantees that there are no loops).
+			if (nodeOrder[connection.inNode] >= nodeOrder[connection.outNode])
+				return false;
+
+			// Connections must be sorted by innovation number, with no duplicates.
+			if (i > 0 && connections[i - 1].innovationNumber >= connection.innovationNumber)
+				return false;
+			if (connection.innovationNumber >= header_->innovationCount || connection.innovationNumber >= InnovationRegistry::maxInnovationCount_c)
+				return false;
+		}
+
+		return true;
+	}
+
+	Genome PopulationFile::constructGenome(size_t index) const
+	{
+		const auto& record = records_[index];
+		const unsigned char* data = data_ + record.dataOffset;
+		const auto layout = genomeLayout(record.nodeCount, record.connectionCount);
+
+		return Genome(record.inputCount, record.outputCount, record.nodeCount,
+			reinterpret_cast<const Genome::Topology::Connection*>(data),
+			reinterpret_cast<const float*>(data + layout.weightsOffset),
+			reinterpret_cast<const uint64_t*>(data + layout.expressedOffset),
+			record.connectionCount,
+			reinterpret_cast<const uint64_t*>(data + layout.topologicalOrderOffset),
+			reinterpret_cast<const uint64_t*>(data + layout.nodeIdsOffset));
+	}
+
+	void PopulationFile::reserveIds() const
+	{
+		// New mutations must not reuse the innovation numbers or node ids of the loaded genomes.
+		Genome::innovationRegistry().reserveInnovationNumbers(innovationCount());
+		Genome::innovationRegistry().reserveNodeIds(nextNodeId());
+	}
+
+}
@@ -0,0 +1,149 @@
+#ifndef POPULATION_FILE_H
+#define POPULATION_FILE_H
+
+#include "NEAT.h"
+
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace neat
+{
+	/// <summary>
+	/// A versioned binary file containing a single genome or a whole population.
+	/// 
+	/// The file is memory-mapped and read in place: every array of a genome is stored exactly as the genome and its topology keep it in memory,
+	/// so loading a genome is a bulk copy of each array rather than parsing each field. Only the per-node connection lists are rebuilt.
+	/// 
+	/// Layout (native byte order, every section 8-byte aligned):
+	///   FileHeader
+	///   GenomeRecord[genomeCount]
+	///   For each genome: Topology::Connection[connectionCount], float weights[connectionCount], uint64_t expressed[(connectionCount + 63) / 64], uint64_t topologicalOrder[nodeCount], uint64_t nodeIds[nodeCount]
+	/// </summary>
+	class PopulationFile
+	{
+	public:
+		enum class Kind : uint32_t
+		{
+			GENOME = 0,
+			POPULATION = 1
+		};
+
+		static constexpr uint32_t version_c = 3;
+
+		/// <summary>
+		/// Maps the file and validates its header and genome table. Check isValid() before using it.
+		/// </summary>
+		explicit PopulationFile(const std::string& fileName);
+		~PopulationFile();
+
+		PopulationFile(const PopulationFile&) = delete;
+		PopulationFile& operator=(const PopulationFile&) = delete;
+
+		// Public methods
+		/// <summary>
+		/// Loads a single genome from the file, and reserves its innovation numbers and node ids in the innovation registry. The genome's contents are validated first.
+		/// </summary>
+		/// <returns>The genome, or nothing if the genome's data is invalid. </returns>
+		[[nodiscard]] std::optional<Genome> loadGenome(size_t index) const;
+
+		/// <summary>
+		/// Loads every genome in the file, and reserves their innovation numbers and node ids in the innovation registry, so evolution can continue from them.
+		/// </summary>
+		/// <returns>False if any genome is invalid, in which case nothing is loaded. </returns>
+		bool loadPopulation(std::vector<Genome>& population) const;
+
+		/// <summary>
+		/// Writes a single genome to a file.
+		/// </summary>
+		/// <returns>False if the file couldn't be written. </returns>
+		static bool write(const std::string& fileName, const Genome& genome);
+
+		/// <summary>
+		/// Writes a whole population to a file.
+		/// </summary>
+		/// <returns>False if the file couldn't be written. </returns>
+		static bool write(const std::string& fileName, const std::vector<Genome>& population);
+
+		// Getters
+		[[nodiscard]] inline bool isValid() const { return header_ != nullptr; };
+		[[nodiscard]] inline Kind kind() const { return static_cast<Kind>(header_->kind); };
+		[[nodiscard]] inline size_t genomeCount() const { return header_->genomeCount; };
+		// One more than the largest innovation number used by any genome in the file.
+		[[nodiscard]] inline uint64_t innovationCount() const { return header_->innovationCount; };
+		// One more than the largest hidden node id used by any genome in the file (at least InnovationRegistry::firstNodeId_c).
+		[[nodiscard]] inline uint64_t nextNodeId() const { return header_->nextNodeId; };
+
+	private:
+		struct FileHeader
+		{
+			char magic[4];
+			uint32_t byteOrderMark;
+			uint32_t version;
+			uint32_t kind;
+			uint64_t genomeCount;
+			uint64_t innovationCount;
+			uint64_t nextNodeId;
+		};
+
+		struct GenomeRecord
+		{
+			uint64_t inputCount;
+			uint64_t outputCount;
+			// Including the bias node.
+			uint64_t nodeCount;
+			uint64_t connectionCount;
+			// Offset (from the start of the file) of the genome's arrays.
+			uint64_t dataOffset;
+		};
+
+		static constexpr char magic_c[4] = { 'N', 'E', 'A', 'T' };
+		static constexpr uint32_t byteOrderMark_c = 0x01020304;
+
+		const unsigned char* data_ = nullptr;
+		size_t size_ = 0;
+
+		const FileHeader* header_ = nullptr;
+		const GenomeRecord* records_ = nullptr;
+
+#ifdef _WIN32
+		void* fileHandle_ = nullptr;
+		void* mappingHandle_ = nullptr;
+#else
+		int fileDescriptor_ = -1;
+#endif
+
+		// Private methods
+		[[nodiscard]] bool validateHeader() const;
+		[[nodiscard]] bool validateGenome(size_t index) const;
+		[[nodiscard]] Genome constructGenome(size_t index) const;
+		void reserveIds() const;
+
+		static bool write(const std::string& fileName, const Genome* const* genomes, size_t genomeCount, Kind kind);
+
+		/// <summary>
+		/// Where the arrays of a genome are, relative to its data offset.
+		/// </summary>
+		struct GenomeLayout
+		{
+			uint64_t weightsOffset;
+			uint64_t expressedOffset;
+			uint64_t topologicalOrderOffset;
+			uint64_t nodeIdsOffset;
+			uint64_t size;
+		};
+
+		// A connection and its weight take 16 bytes together, so every array starts 8-byte aligned.
+		[[nodiscard]] static inline GenomeLayout genomeLayout(uint64_t nodeCount, uint64_t connectionCount)
+		{
+			const uint64_t weightsOffset = connectionCount * sizeof(Genome::Topology::Connection);
+			const uint64_t expressedOffset = weightsOffset + connectionCount * sizeof(float);
+			const uint64_t topologicalOrderOffset = expressedOffset + (connectionCount + 63) / 64 * sizeof(uint64_t);
+			const uint64_t nodeIdsOffset = topologicalOrderOffset + nodeCount * sizeof(uint64_t);
+			return { weightsOffset, expressedOffset, topologicalOrderOffset, nodeIdsOffset, nodeIdsOffset + nodeCount * sizeof(uint64_t) };
+		}
+	};
+
+}
+
+#endif /* POPULATION_FILE_H */
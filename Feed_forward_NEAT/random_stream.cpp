@@ -0,0 +1,66 @@
+#include "random_stream.h"
+
+namespace neat
+{
+
+	/// <summary>
+	/// Seeds the four generators with SplitMix64. Each stream index gets its own 8 SplitMix64 outputs, so different streams never share a starting state.
+	/// </summary>
+	RandomStream::RandomStream(uint64_t seed, uint64_t streamIndex)
+	{
+		constexpr uint64_t golden = 0x9e3779b97f4a7c15ULL;
+		uint64_t counter = seed + streamIndex * 8 * golden;
+
+		const auto splitMix64 = [&counter]()
+		{
+			uint64_t z = (counter += golden);
+			z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+			z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+			return z ^ (z >> 31);
+		};
+
+		for (int lane = 0; lane < 4; lane++)
+		{
+			for (int word = 0; word < 4; word += 2)
+			{
+				const uint64_t value = splitMix64();
+				state_[word][lane] = static_cast<uint32_t>(value);
+				state_[word + 1][lane] = static_cast<uint32_t>(value >> 32);
+			}
+		}
+	}
+
+	void RandomStream::nextBits(uint64_t bits[2])
+	{
+		uint32_t results[4];
+		nextIntegers(results);
+		bits[0] = (static_cast<uint64_t>(results[1]) << 32) | results[0];
+		bits[1] = (static_cast<uint64_t>(results[3]) << 32) | results[2];
+	}
+
+	/// <summary>
+	/// Advances the four generators without SIMD.
+	/// </summary>
+	void RandomStream::nextIntegers(uint32_t results[4])
+	{
+		for (int lane = 0; lane < 4; lane++)
+		{
+			uint32_t& s0 = state_[0][lane];
+			uint32_t& s1 = state_[1][lane];
+			uint32_t& s2 = state_[2][lane];
+			uint32_t& s3 = state_[3][lane];
+
+			const uint32_t sum = s0 + s3;
+			results[lane] = ((sum << 7) | (sum >> 25)) + s0;
+			const uint32_t t = s1 << 9;
+
+			s2 ^= s0;
+			s3 ^= s1;
+			s1 ^= s2;
+			s0 ^= s3;
+			s2 ^= t;
+			s3 = (s3 << 11) | (s3 >> 21);
+		}
+	}
+
+}
@@ -0,0 +1,88 @@
+#ifndef RANDOM_STREAM_H
+#define RANDOM_STREAM_H
+
+#include "simd.h"
+
+#include <cstdint>
+
+namespace neat
+{
+	/// <summary>
+	/// Four independent xoshiro128++ generators that are advanced together, producing four uniform floats at a time (with SSE2 where available).
+	/// Unlike xoshiro128+, whose lowest bits are weak, every bit of the output is usable, which nextBits relies on.
+	/// Much cheaper than drawing from a std::uniform_real_distribution one value at a time, but only meant for mutations, not anything statistically demanding.
+	/// A stream is not thread safe. Threads should each use their own stream, with a different seed.
+	/// </summary>
+	class RandomStream
+	{
+	public:
+		// Streams with the same seed but different stream indices never start in the same state.
+		explicit RandomStream(uint64_t seed, uint64_t streamIndex = 0);
+
+		// Public methods
+		/// <summary>
+		/// Writes four uniform floats in [0, 1) to values.
+		/// </summary>
+		inline void nextFloats(float values[4])
+		{
+#if defined(NEAT_SSE_ENABLED)
+			_mm_storeu_ps(values, nextFloats());
+#else
+			uint32_t results[4];
+			nextIntegers(results);
+			for (int i = 0; i < 4; i++)
+				values[i] = (results[i] >> 8) * floatScale_c;
+#endif
+		}
+
+		/// <summary>
+		/// Writes 128 uniform random bits to bits, for drawing many 50% (or, combined, 25% and 75%) decisions at once.
+		/// </summary>
+		void nextBits(uint64_t bits[2]);
+
+#if defined(NEAT_SSE_ENABLED)
+		/// <summary>
+		/// Returns four uniform floats in [0, 1).
+		/// </summary>
+		inline __m128 nextFloats()
+		{
+			const __m128i s0 = _mm_load_si128(reinterpret_cast<const __m128i*>(state_[0]));
+			__m128i s1 = _mm_load_si128(reinterpret_cast<const __m128i*>(state_[1]));
+			__m128i s2 = _mm_load_si128(reinterpret_cast<const __m128i*>(state_[2]));
+			__m128i s3 = _mm_load_si128(reinterpret_cast<const __m128i*>(state_[3]));
+
+			// rotl(s0 + s3, 7) + s0
+			const __m128i sum = _mm_add_epi32(s0, s3);
+			const __m128i result = _mm_add_epi32(_mm_or_si128(_mm_slli_epi32(sum, 7), _mm_srli_epi32(sum, 25)), s0);
+			const __m128i t = _mm_slli_epi32(s1, 9);
+
+			s2 = _mm_xor_si128(s2, s0);
+			s3 = _mm_xor_si128(s3, s1);
+			s1 = _mm_xor_si128(s1, s2);
+			const __m128i newS0 = _mm_xor_si128(s0, s3);
+			s2 = _mm_xor_si128(s2, t);
+			s3 = _mm_or_si128(_mm_slli_epi32(s3, 11), _mm_srli_epi32(s3, 21));
+
+			_mm_store_si128(reinterpret_cast<__m128i*>(state_[0]), newS0);
+			_mm_store_si128(reinterpret_cast<__m128i*>(state_[1]), s1);
+			_mm_store_si128(reinterpret_cast<__m128i*>(state_[2]), s2);
+			_mm_store_si128(reinterpret_cast<__m128i*>(state_[3]), s3);
+
+			// The top 24 bits fit exactly in a float's mantissa.
+			return _mm_mul_ps(_mm_cvtepi32_ps(_mm_srli_epi32(result, 8)), _mm_set1_ps(floatScale_c));
+		}
+#endif
+
+	private:
+		static constexpr float floatScale_c = 1.0f / 16777216.0f; // 2^-24
+
+		// state_[word][lane]. Aligned, so each word of all four generators can be loaded as one vector.
+		alignas(16) uint32_t state_[4][4];
+
+		// Private methods
+		void nextIntegers(uint32_t results[4]);
+	};
+
+}
+
+#endif /* RANDOM_STREAM_H */
@@ -0,0 +1,10 @@
+#ifndef SIMD_H
+#define SIMD_H
+
+// SSE2 is part of x86-64, so it's always available there. Everything that uses it also has a plain fallback.
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define NEAT_SSE_ENABLED
+#include <immintrin.h>
+#endif
+
+#endif /* SIMD_H */
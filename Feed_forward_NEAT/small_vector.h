@@ -0,0 +1,201 @@
+#ifndef SMALL_VECTOR_H
+#define SMALL_VECTOR_H
+
+#include <algorithm>
+#include <type_traits>
+#include <cassert>
+#include <cstring>
+#include <cstddef>
+
+namespace neat
+{
+	/// <summary>
+	/// A vector that keeps up to InlineCapacity elements inside itself, and only allocates on the heap once it grows past that.
+	/// Small genomes are copied thousands of times per generation, and this keeps those copies free of allocations.
+	/// Only for trivially copyable types, so elements can be moved around with memcpy. New elements from resize are value initialized.
+	/// </summary>
+	template<typename T, size_t InlineCapacity>
+	class SmallVector
+	{
+		static_assert(std::is_trivially_copyable_v<T>, "SmallVector only supports trivially copyable types!");
+		static_assert(InlineCapacity > 0, "SmallVector needs room for at least one inline element!");
+
+	public:
+		using value_type = T;
+		using iterator = T*;
+		using const_iterator = const T*;
+
+		SmallVector() = default;
+		SmallVector(size_t count, const T& value) { assign(count, value); };
+
+		SmallVector(const SmallVector& other) { *this = other; };
+		SmallVector(SmallVector&& other) noexcept { *this = std::move(other); };
+		~SmallVector() { freeHeap(); };
+
+		SmallVector& operator=(const SmallVector& other)
+		{
+			if (this == &other)
+				return *this;
+
+			if (other.size_ > capacity_)
+				reallocate(other.size_);
+
+			copyElements(data_, other.data_, other.size_);
+			size_ = other.size_;
+			return *this;
+		}
+
+		SmallVector& operator=(SmallVector&& other) noexcept
+		{
+			if (this == &other)
+				return *this;
+
+			// Heap storage is taken over, inline storage has to be copied.
+			if (!other.isInline())
+			{
+				freeHeap();
+				data_ = other.data_;
+				capacity_ = other.capacity_;
+				size_ = other.size_;
+
+				other.data_ = other.inline_;
+				other.capacity_ = InlineCapacity;
+				other.size_ = 0;
+				return *this;
+			}
+
+			copyElements(data_, other.data_, other.size_);
+			size_ = other.size_;
+			other.size_ = 0;
+			return *this;
+		}
+
+		// Public methods
+		[[nodiscard]] inline T& operator[](size_t index) { assert(index < size_ && "Index out of range!"); return data_[index]; };
+		[[nodiscard]] inline const T& operator[](size_t index) const { assert(index < size_ && "Index out of range!"); return data_[index]; };
+
+		[[nodiscard]] inline iterator begin() { return data_; };
+		[[nodiscard]] inline iterator end() { return data_ + size_; };
+		[[nodiscard]] inline const_iterator begin() const { return data_; };
+		[[nodiscard]] inline const_iterator end() const { return data_ + size_; };
+
+		[[nodiscard]] inline T& back() { assert(size_ > 0 && "Vector is empty!"); return data_[size_ - 1]; };
+		[[nodiscard]] inline const T& back() const { assert(size_ > 0 && "Vector is empty!"); return data_[size_ - 1]; };
+
+		inline void push_back(const T& value)
+		{
+			if (size_ == capacity_)
+			{
+				// The value could be an element of this vector, which is about to move.
+				const T copy = value;
+				reallocate(capacity_ * 2);
+				data_[size_++] = copy;
+				return;
+			}
+
+			data_[size_++] = value;
+		}
+
+		iterator insert(const_iterator position, const T& value)
+		{
+			const size_t index = position - data_;
+			assert(index <= size_ && "Insert position out of range!");
+
+			const T copy = value;
+			if (size_ == capacity_)
+				reallocate(capacity_ * 2);
+
+			std::memmove(data_ + index + 1, data_ + index, (size_ - index) * sizeof(T));
+			data_[index] = copy;
+			size_++;
+
+			return data_ + index;
+		}
+
+		void assign(size_t count, const T& value)
+		{
+			if (count > capacity_)
+				reallocate(count);
+
+			std::fill(data_, data_ + count, value);
+			size_ = count;
+		}
+
+		void assign(const T* first, const T* last)
+		{
+			const size_t count = last - first;
+			if (count > capacity_)
+				reallocate(count);
+
+			copyElements(data_, first, count);
+			size_ = count;
+		}
+
+		inline void resize(size_t count) { resize(count, T{}); };
+
+		void resize(size_t count, const T& value)
+		{
+			if (count > capacity_)
+				reallocate(std::max(count, capacity_ * 2));
+
+			if (count > size_)
+				std::fill(data_ + size_, data_ + count, value);
+			size_ = count;
+		}
+
+		inline void reserve(size_t count)
+		{
+			if (count > capacity_)
+				reallocate(count);
+		}
+
+		// Keeps any heap storage, so a vector that grew once doesn't allocate again.
+		inline void clear() { size_ = 0; };
+
+		[[nodiscard]] bool operator==(const SmallVector& other) const { return size_ == other.size_ && std::equal(begin(), end(), other.begin()); };
+		[[nodiscard]] bool operator!=(const SmallVector& other) const { return !(*this == other); };
+
+		// Getters
+		[[nodiscard]] inline T* data() { return data_; };
+		[[nodiscard]] inline const T* data() const { return data_; };
+		[[nodiscard]] inline size_t size() const { return size_; };
+		[[nodiscard]] inline bool empty() const { return size_ == 0; };
+		[[nodiscard]] inline size_t capacity() const { return capacity_; };
+		// Whether the elements are stored inside the vector itself (nothing was allocated).
+		[[nodiscard]] inline bool isInline() const { return data_ == inline_; };
+
+	private:
+		T inline_[InlineCapacity];
+		T* data_ = inline_;
+		size_t size_ = 0;
+		size_t capacity_ = InlineCapacity;
+
+		// Private methods
+		static inline void copyElements(T* destination, const T* source, size_t count)
+		{
+			if (count > 0)
+				std::memcpy(destination, source, count * sizeof(T));
+		}
+
+		void reallocate(size_t capacity)
+		{
+			assert(capacity >= size_ && "Reallocation would lose elements!");
+
+			T* newData = new T[capacity];
+			copyElements(newData, data_, size_);
+			freeHeap();
+
+			data_ = newData;
+			capacity_ = capacity;
+		}
+
+		inline void freeHeap()
+		{
+			if (!isInline())
+				delete[] data_;
+		}
+	};
+
+}
+
+#endif /* SMALL_VECTOR_H */
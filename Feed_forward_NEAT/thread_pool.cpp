@@ -0,0 +1,228 @@
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <iostream>
+
+#if defined(_WIN32)
+#define NOMINMAX
+#include <windows.h>
+#elif defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+
+namespace neat
+{
+
+	ThreadPool::ThreadPool(size_t threadCount, bool pinThreads)
+	{
+		const size_t hardwareThreads = std::max(1u, std::thread::hardware_concurrency());
+		if (threadCount == 0)
+			threadCount = hardwareThreads;
+
+		shares_ = std::make_unique<Share[]>(threadCount);
+
+		workers_.reserve(threadCount - 1);
+		for (size_t i = 1; i < threadCount; i++)
+		{
+			workers_.emplace_back(&ThreadPool::workerLoop, this, i);
+			if (pinThreads)
+				pinToCore(workers_.back(), i % hardwareThreads);
+		}
+	}
+
+	ThreadPool::~ThreadPool()
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			stopping_ = true;
+		}
+		loopStarted_.notify_all();
+
+		for (auto& worker : workers_)
+			worker.join();
+	}
+
+	void ThreadPool::parallelFor(size_t count, FunctionRef<void(size_t)> body, size_t grainSize)
+	{
+		run(count, grainSize, [&body](size_t begin, size_t end, size_t)
+			{
+				for (size_t i = begin; i < end; i++)
+					body(i);
+			});
+	}
+
+	void ThreadPool::parallelForRanges(size_t count, FunctionRef<void(size_t, size_t)> body, size_t grainSize)
+	{
+		run(count, grainSize, [&body](size_t begin, size_t end, size_t) { body(begin, end); });
+	}
+
+	void ThreadPool::parallelForInOrder(size_t count, FunctionRef<void(size_t)> body)
+	{
+		// Every thread gets one (stealable) item, which keeps taking indices from the shared counter until there are none left.
+		std::atomic<size_t> nextIndex = 0;
+		run(std::min(count, threadCount()), 1, [&](size_t, size_t, size_t)
+			{
+				for (size_t i = nextIndex++; i < count; i = nextIndex++)
+					body(i);
+			});
+	}
+
+	void ThreadPool::run(size_t count, size_t grainSize, const RangeBody& body)
+	{
+		grainSize = std::max<size_t>(1, grainSize);
+
+		// Not worth waking the workers for.
+		if (count == 0)
+			return;
+		if (workers_.empty() || count <= grainSize)
+		{
+			body(0, count, 0);
+			return;
+		}
+
+		std::lock_guard<std::mutex> loopLock(loopMutex_);
+
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+
+			const size_t threads = threadCount();
+			for (size_t t = 0; t < threads; t++)
+			{
+				std::lock_guard<std::mutex> shareLock(shares_[t].mutex);
+				shares_[t].begin = count * t / threads;
+				shares_[t].end = count * (t + 1) / threads;
+			}
+
+			body_ = &body;
+			grainSize_ = grainSize;
+			loopId_++;
+		}
+		loopStarted_.notify_all();
+
+		work(0, grainSize, body);
+
+		// Workers that wake up after this point see that there is no loop anymore.
+		std::unique_lock<std::mutex> lock(mutex_);
+		loopFinished_.wait(lock, [this]() { return activeWorkers_ == 0; });
+		body_ = nullptr;
+	}
+
+	void ThreadPool::workerLoop(size_t threadIndex)
+	{
+		uint64_t lastLoopId = 0;
+
+		std::unique_lock<std::mutex> lock(mutex_);
+		while (true)
+		{
+			loopStarted_.wait(lock, [&]() { return stopping_ || loopId_ != lastLoopId; });
+			if (stopping_)
+				return;
+
+			lastLoopId = loopId_;
+			if (!body_)
+				continue;
+
+			const auto& body = *body_;
+			const size_t grainSize = grainSize_;
+			activeWorkers_++;
+
+			lock.unlock();
+			work(threadIndex, grainSize, body);
+			lock.lock();
+
+			if (--activeWorkers_ == 0)
+				loopFinished_.notify_all();
+		}
+	}
+
+	/// <summary>
+	/// Works through the thread's own share, and then steals from the others until there is nothing left anywhere.
+	/// Shares only ever shrink during a loop, so once every share is empty, the loop is done (apart from the ranges other threads are still running).
+	/// </summary>
+	void ThreadPool::work(size_t threadIndex, size_t grainSize, const RangeBody& body)
+	{
+		size_t begin, end;
+		while (takeOwn(threadIndex, grainSize, begin, end) || (steal(threadIndex) && takeOwn(threadIndex, grainSize, begin, end)))
+			body(begin, end, threadIndex);
+	}
+
+	bool ThreadPool::takeOwn(size_t threadIndex, size_t grainSize, size_t& begin, size_t& end)
+	{
+		auto& share = shares_[threadIndex];
+		std::lock_guard<std::mutex> lock(share.mutex);
+		if (share.begin >= share.end)
+			return false;
+
+		begin = share.begin;
+		end = std::min(share.end, begin + grainSize);
+		share.begin = end;
+		return true;
+	}
+
+	/// <summary>
+	/// Moves the back half of the largest share of another thread into this thread's (empty) share.
+	/// </summary>
+	/// <returns>Whether anything was stolen. </returns>
+	bool ThreadPool::steal(size_t threadIndex)
+	{
+		const size_t threads = threadCount();
+		while (true)
+		{
+			// The sizes can change as soon as they have been read, which only makes the choice of victim worse, never wrong.
+			size_t victim = threadIndex;
+			size_t largestRemaining = 0;
+			for (size_t offset = 1; offset < threads; offset++)
+			{
+				const size_t t = (threadIndex + offset) % threads;
+				std::lock_guard<std::mutex> lock(shares_[t].mutex);
+				const size_t remaining = shares_[t].end - std::min(shares_[t].begin, shares_[t].end);
+				if (remaining > largestRemaining)
+				{
+					victim = t;
+					largestRemaining = remaining;
+				}
+			}
+
+			if (victim == threadIndex)
+				return false;
+
+			size_t begin, end;
+			{
+				std::lock_guard<std::mutex> lock(shares_[victim].mutex);
+				auto& share = shares_[victim];
+				if (share.begin >= share.end)
+					continue;
+
+				// Taking the back half leaves the victim the part it is about to work on. A single remaining item is taken whole.
+				begin = share.end - std::max<size_t>(1, (share.end - share.begin) / 2);
+				end = share.end;
+				share.end = begin;
+			}
+
+			std::lock_guard<std::mutex> lock(shares_[threadIndex].mutex);
+			shares_[threadIndex].begin = begin;
+			shares_[threadIndex].end = end;
+			return true;
+		}
+	}
+
+	void ThreadPool::pinToCore(std::thread& thread, size_t core)
+	{
+#if defined(_WIN32)
+		if (!SetThreadAffinityMask(thread.native_handle(), DWORD_PTR{ 1 } << core))
+			std::cerr << "Failed to pin worker thread to core " << core << "!" << std::endl;
+#elif defined(__linux__)
+		cpu_set_t mask;
+		CPU_ZERO(&mask);
+		CPU_SET(core, &mask);
+		if (pthread_setaffinity_np(thread.native_handle(), sizeof(mask), &mask) != 0)
+			std::cerr << "Failed to pin worker thread to core " << core << "!" << std::endl;
+#else
+		(void)thread;
+		(void)core;
+#endif
+	}
+
+}
@@ -0,0 +1,115 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <vector>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <cstdint>
+
+#include "function_ref.h"
+
+namespace neat
+{
+	/// <summary>
+	/// A fixed set of worker threads that run parallel loops with work stealing, so the library's phases (evaluation, mutation, reproduction) don't each have to start their own threads.
+	/// Every thread starts a loop with an equal share of the indices, and works through it from the front, grainSize indices at a time.
+	/// A thread that runs out steals the back half of the largest remaining share it finds, so expensive items at the end of one share don't leave the other threads idle.
+	/// The thread calling a loop works along with the workers. Only one loop runs at a time; loops must not be started from inside a loop body.
+	/// </summary>
+	class ThreadPool
+	{
+	public:
+		// A threadCount of 0 uses every hardware thread. The calling thread counts as one of them, so a threadCount of 1 starts no workers at all.
+		// Pinned workers each stay on their own core (the calling thread is left alone), which keeps their caches warm between loops.
+		explicit ThreadPool(size_t threadCount = 0, bool pinThreads = false);
+		~ThreadPool();
+
+		ThreadPool(const ThreadPool&) = delete;
+		ThreadPool& operator=(const ThreadPool&) = delete;
+
+		// Public methods
+		/// <summary>
+		/// Calls body(i) for every i in [0, count), spread over the threads, and returns once every call has finished.
+		/// </summary>
+		void parallelFor(size_t count, FunctionRef<void(size_t)> body, size_t grainSize = 1);
+
+		/// <summary>
+		/// Calls body(begin, end) for consecutive ranges that together cover [0, count), spread over the threads. Cheaper than parallelFor for small items.
+		/// </summary>
+		void parallelForRanges(size_t count, FunctionRef<void(size_t, size_t)> body, size_t grainSize = 1);
+
+		/// <summary>
+		/// Calls body(i) for every i in [0, count), starting the indices in increasing order, one at a time, on whichever thread is free first.
+		/// Meant for items sorted from most to least expensive (longest processing time first), which keeps a big item from starting last and holding up the rest.
+		/// </summary>
+		void parallelForInOrder(size_t count, FunctionRef<void(size_t)> body);
+
+		/// <summary>
+		/// Combines map(i) for every i in [0, count) with combine, starting from identity on each thread.
+		/// The order in which items are combined depends on the scheduling, so combine should be associative and commutative.
+		/// </summary>
+		template<typename T, typename Map, typename Combine>
+		[[nodiscard]] T parallelReduce(size_t count, T identity, Map map, Combine combine, size_t grainSize = 1)
+		{
+			std::vector<T> partials(threadCount(), identity);
+			run(count, grainSize, [&](size_t begin, size_t end, size_t threadIndex)
+				{
+					T partial = std::move(partials[threadIndex]);
+					for (size_t i = begin; i < end; i++)
+						partial = combine(std::move(partial), map(i));
+					partials[threadIndex] = std::move(partial);
+				});
+
+			T result = std::move(identity);
+			for (auto& partial : partials)
+				result = combine(std::move(result), std::move(partial));
+			return result;
+		}
+
+		// Getters
+		[[nodiscard]] inline size_t threadCount() const { return workers_.size() + 1; };
+
+	private:
+		using RangeBody = FunctionRef<void(size_t, size_t, size_t)>;
+
+		// The indices a thread still has to do. The owner takes from the front, thieves from the back.
+		struct alignas(64) Share
+		{
+			std::mutex mutex;
+			size_t begin = 0;
+			size_t end = 0;
+		};
+
+		std::vector<std::thread> workers_{};
+		// One per thread. The calling thread is 0, worker i is i + 1.
+		std::unique_ptr<Share[]> shares_;
+
+		// Makes sure only one loop runs at a time.
+		std::mutex loopMutex_{};
+
+		// Everything below is guarded by mutex_.
+		std::mutex mutex_{};
+		std::condition_variable loopStarted_{};
+		std::condition_variable loopFinished_{};
+		const RangeBody* body_ = nullptr;
+		size_t grainSize_ = 1;
+		uint64_t loopId_ = 0;
+		size_t activeWorkers_ = 0;
+		bool stopping_ = false;
+
+		// Private methods
+		void run(size_t count, size_t grainSize, const RangeBody& body);
+		void workerLoop(size_t threadIndex);
+		void work(size_t threadIndex, size_t grainSize, const RangeBody& body);
+		[[nodiscard]] bool takeOwn(size_t threadIndex, size_t grainSize, size_t& begin, size_t& end);
+		[[nodiscard]] bool steal(size_t threadIndex);
+
+		static void pinToCore(std::thread& thread, size_t core);
+	};
+
+}
+
+#endif /* THREAD_POOL_H */
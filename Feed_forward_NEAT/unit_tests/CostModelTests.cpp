@@ -0,0 +1,125 @@
+#include <gtest/gtest.h>
+
+#include <cost_model.h>
+#include <evaluator.h>
+
+#include <atomic>
+#include <vector>
+
+
+TEST(CostModelTests, FitsMeasuredTimes)
+{
+	neat::EvaluationCostModel model;
+
+	// Before any measurements, bigger genomes are still predicted to be more expensive.
+	EXPECT_GT(model.predict(100, 20), model.predict(10, 5));
+
+	// seconds = 2 + 3 * connections + 5 * nodes
+	for (size_t connections = 1; connections < 10; connections++)
+	{
+		for (size_t nodes = 1; nodes < 10; nodes += 3)
+			model.addMeasurement(connections, nodes, 2.0 + 3.0 * connections + 5.0 * nodes);
+	}
+	model.update();
+
+	EXPECT_NEAR(model.coefficients()[0], 2.0, 1e-3);
+	EXPECT_NEAR(model.coefficients()[1], 3.0, 1e-3);
+	EXPECT_NEAR(model.coefficients()[2], 5.0, 1e-3);
+	EXPECT_NEAR(model.predict(50, 20), 2.0 + 150.0 + 100.0, 1e-2);
+}
+
+TEST(CostModelTests, KeepsCoefficientsWithoutEnoughInformation)
+{
+	neat::EvaluationCostModel model;
+	const auto initialCoefficients = model.coefficients();
+
+	// Genomes of a single size can't tell the overhead apart from the cost per connection and node.
+	for (size_t i = 0; i < 20; i++)
+		model.addMeasurement(10, 5, 1.0);
+	model.update();
+	EXPECT_EQ(model.coefficients(), initialCoefficients);
+
+	// Neither can genomes whose node count always follows from their connection count.
+	neat::EvaluationCostModel collinearModel;
+	for (size_t connections = 1; connections < 20; connections++)
+		collinearModel.addMeasurement(connections, 2 * connections + 1, 3.0 * connections);
+	collinearModel.update();
+	EXPECT_EQ(collinearModel.coefficients(), initialCoefficients);
+}
+
+namespace
+{
+	// Sums the first output over a fixed set of inputs, and allows splitting that sum into chunks.
+	class SummingEvaluator : public neat::Evaluator
+	{
+	public:
+		explicit SummingEvaluator(std::vector<neat::Genome>&& genomes)
+			: neat::Evaluator(genomes.size(), 3.0f, 1.0f, 1.0f, 0.4f, 0, 4)
+		{
+			genomes_ = std::move(genomes);
+			for (size_t i = 0; i < 64; i++)
+				samples_.push_back({ i / 64.0f, 1.0f - i / 64.0f });
+		}
+
+		float fitnessOf(size_t genomeIndex)
+		{
+			calculateFitnesses();
+			return genomeFitness(genomeIndex);
+		}
+
+		std::atomic<size_t> chunkCount = 0;
+
+	protected:
+		float evaluateGenomeTraining(neat::Genome& genome) override
+		{
+			return evaluateGenomeTrainingSamples(genome, 0, samples_.size());
+		}
+
+		FitnessCorrectpercentagePair evaluateGenomeTest(neat::Genome&) override { return { 0.0f, 0.0f }; }
+
+		size_t trainingSampleCount() const override { return samples_.size(); }
+
+		float evaluateGenomeTrainingSamples(neat::Genome& genome, size_t begin, size_t end) override
+		{
+			if (end - begin != samples_.size())
+				chunkCount++;
+
+			float sum = 0;
+			for (size_t i = begin; i < end; i++)
+			{
+				genome.setInputValues(samples_[i]);
+				genome.evaluateOutputNodes();
+				sum += genome.getOutputValue(0);
+			}
+
+			return sum;
+		}
+
+	private:
+		std::vector<std::vector<float>> samples_;
+	};
+}
+
+TEST(CostModelTests, ExpensiveGenomesAreSplitIntoChunks)
+{
+	// One large genome among small ones.
+	std::vector<neat::Genome> genomes(8, neat::Genome{ 2, 1 });
+	for (size_t i = 0; i < genomes.size(); i++)
+		genomes[i].addConnectionGene(i % 3, 3, 0.5f + i);
+	for (size_t i = 0; i < 40; i++)
+		genomes[0].addNodeMutation().addConnectionMutation();
+
+	// The expected fitness, from evaluating the large genome in one piece.
+	neat::Genome large = genomes[0];
+	float expected = 0;
+	for (size_t i = 0; i < 64; i++)
+	{
+		large.setInputValues({ i / 64.0f, 1.0f - i / 64.0f });
+		large.evaluateOutputNodes();
+		expected += large.getOutputValue(0);
+	}
+
+	SummingEvaluator evaluator{ std::move(genomes) };
+	EXPECT_NEAR(evaluator.fitnessOf(0), expected, 1e-3f);
+	EXPECT_GT(evaluator.chunkCount, 1);
+}
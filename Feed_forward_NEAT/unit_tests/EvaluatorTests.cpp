@@ -0,0 +1,183 @@
+#include <gtest/gtest.h>
+
+#include <evaluator.h>
+#include <benchmarks/allocation_counter.h>
+
+#include <algorithm>
+#include <atomic>
+#include <vector>
+
+
+namespace
+{
+	// Rewards a large first output for a fixed input, and counts the evaluations.
+	class OutputEvaluator : public neat::Evaluator
+	{
+	public:
+		explicit OutputEvaluator(size_t populationSize, size_t fitnessCacheSize = 0, size_t threadCount = 4, float compatibilityDistanceCutoff = 3.0f)
+			: neat::Evaluator(populationSize, compatibilityDistanceCutoff, 1.0f, 1.0f, 0.4f, fitnessCacheSize, threadCount), compatibilityDistanceCutoff_(compatibilityDistanceCutoff)
+		{
+			for (size_t i = 0; i < populationSize; i++)
+				genomes_.emplace_back(2, 1).addConnectionMutation();
+		}
+
+		// Makes every genome a copy of the first one.
+		void copyFirstGenome()
+		{
+			for (auto& genome : genomes_)
+				genome = genomes_[0];
+		}
+
+		void evaluate() { calculateFitnesses(); }
+
+		// Gives the genomes between 0 and 7 extra nodes and connections, so they differ in size.
+		void diversifyStructure()
+		{
+			for (size_t i = 0; i < genomes_.size(); i++)
+			{
+				for (size_t m = 0; m < i % 8; m++)
+				{
+					genomes_[i].addNodeMutation();
+					genomes_[i].addConnectionMutation();
+				}
+			}
+		}
+
+		// The number of species that placing every genome into the first species (by its first genome) within the cutoff, or a new one, gives.
+		size_t speciesCountComparingEverySpecies() const
+		{
+			std::vector<const neat::Genome*> mascots;
+			for (const auto& genome : genomes_)
+			{
+				const bool fitsAny = std::any_of(mascots.begin(), mascots.end(), [&](const neat::Genome* mascot)
+					{
+						return mascot->calculateCompatibilityDistance(genome, 1.0f, 1.0f, 0.4f) < compatibilityDistanceCutoff_;
+					});
+				if (!fitsAny)
+					mascots.push_back(&genome);
+			}
+
+			return mascots.size();
+		}
+
+		// Only the weights of the genomes are mutated from now on.
+		void keepStructure()
+		{
+			mutateAddNodeChance_ = 0.0f;
+			mutateAddConnectionChance_ = 0.0f;
+		}
+
+		// Whether every genome still has the fitness it would get now.
+		bool fitnessesAreCurrent()
+		{
+			for (size_t i = 0; i < genomes_.size(); i++)
+			{
+				if (genomeFitness(i) != outputOf(genomes_[i]))
+					return false;
+			}
+
+			return true;
+		}
+
+		std::atomic<size_t> evaluationCount = 0;
+
+	protected:
+		float evaluateGenomeTraining(neat::Genome& genome) override
+		{
+			evaluationCount++;
+			return outputOf(genome);
+		}
+
+		FitnessCorrectpercentagePair evaluateGenomeTest(neat::Genome&) override { return { 0.0f, 0.0f }; }
+
+	private:
+		const std::vector<float> inputs_{ 0.5f, 1.0f };
+		const float compatibilityDistanceCutoff_;
+
+		float outputOf(neat::Genome& genome)
+		{
+			genome.resetCache();
+			genome.setInputValues(inputs_);
+			genome.evaluateOutputNodes();
+			return genome.getOutputValue(0);
+		}
+	};
+}
+
+TEST(EvaluatorTests, SteadyStateEvaluatesEveryReplacement)
+{
+	OutputEvaluator evaluator{ 50 };
+	evaluator.evaluate_steadyState(500);
+
+	// The cache is disabled, so the initial population and every offspring are evaluated.
+	EXPECT_EQ(evaluator.populationSize(), 50);
+	EXPECT_LE(evaluator.evaluationCount, 550);
+	EXPECT_GE(evaluator.evaluationCount, 500);
+	EXPECT_TRUE(evaluator.fitnessesAreCurrent());
+
+	// Both modes can be used on the same population.
+	evaluator.evaluate_training();
+	evaluator.evaluate_steadyState(100);
+	EXPECT_EQ(evaluator.populationSize(), 50);
+	EXPECT_TRUE(evaluator.fitnessesAreCurrent());
+}
+
+TEST(EvaluatorTests, IdenticalGenomesAreOnlyEvaluatedWithCache)
+{
+	OutputEvaluator cachedEvaluator{ 10, 100 };
+	cachedEvaluator.copyFirstGenome();
+	cachedEvaluator.evaluate();
+	EXPECT_EQ(cachedEvaluator.evaluationCount, 1);
+	EXPECT_TRUE(cachedEvaluator.fitnessesAreCurrent());
+
+	// Without the cache, the fitness doesn't have to be deterministic, so copies are evaluated as well.
+	OutputEvaluator evaluator{ 10 };
+	evaluator.copyFirstGenome();
+	evaluator.evaluate();
+	EXPECT_EQ(evaluator.evaluationCount, 10);
+	EXPECT_TRUE(evaluator.fitnessesAreCurrent());
+}
+
+TEST(EvaluatorTests, TrainingKeepsPopulationSize)
+{
+	// With the cache, some species have no genome left to evaluate, and are reproduced without waiting for any evaluation.
+	OutputEvaluator evaluator{ 50, 1000 };
+	for (size_t generation = 0; generation < 20; generation++)
+	{
+		evaluator.evaluate_training();
+		ASSERT_EQ(evaluator.populationSize(), 50);
+	}
+
+	EXPECT_GT(evaluator.evaluationCount, 0);
+}
+
+TEST(EvaluatorTests, SpeciationMatchesComparingEverySpecies)
+{
+	// A cutoff below the excess and disjoint constants only compares genomes with species of a similar size, a larger one compares them with every species.
+	for (float cutoff : { 0.8f, 3.0f })
+	{
+		OutputEvaluator evaluator{ 80, 0, 4, cutoff };
+		evaluator.diversifyStructure();
+		evaluator.evaluate_steadyState(0);
+
+		EXPECT_EQ(evaluator.speciesCount(), evaluator.speciesCountComparingEverySpecies());
+	}
+}
+
+TEST(EvaluatorTests, GenerationsReuseTheirMemory)
+{
+	// Every thread keeps its own scratch space, which it only sizes once it first needs it, so one thread makes the warm-up deterministic.
+	// New species and new structure have to be allocated, so the cutoff keeps the species the same and the genomes keep their structure. Otherwise, a generation only reuses the genomes and scratch space of the ones before it.
+	OutputEvaluator evaluator{ 100, 0, 1, 1000.0f };
+	evaluator.keepStructure();
+
+	for (size_t i = 0; i < 5; i++)
+		evaluator.evaluate_training();
+
+	const size_t allocationsBefore = neat::allocationCount();
+	for (size_t i = 0; i < 5; i++)
+		evaluator.evaluate_training();
+
+	EXPECT_EQ(neat::allocationCount() - allocationsBefore, 0);
+	EXPECT_EQ(evaluator.populationSize(), 100);
+}
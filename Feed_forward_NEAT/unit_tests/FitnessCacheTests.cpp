@@ -0,0 +1,65 @@
+#include <gtest/gtest.h>
+
+#include <NEAT.h>
+#include <fitness_cache.h>
+
+
+namespace
+{
+	neat::Genome createGenome()
+	{
+		neat::Genome genome{ 3, 2 };
+		for (size_t i = 0; i < 8; i++)
+			genome.addConnectionMutation();
+		genome.addNodeMutation();
+
+		return genome;
+	}
+}
+
+TEST(FitnessCacheTests, IdenticalGenomesHitTheCache)
+{
+	neat::FitnessCache cache{ 16 };
+
+	const neat::Genome genome = createGenome();
+	cache.insert(genome, 42.0f);
+
+	// A copy is identical, so it has the same hash and fitness.
+	neat::Genome copy{ genome };
+	EXPECT_EQ(copy.hash(), genome.hash());
+	ASSERT_TRUE(cache.find(copy).has_value());
+	EXPECT_EQ(*cache.find(copy), 42.0f);
+
+	// Any change to the weights or structure makes it a different genome.
+	copy.mutateConnectionGenes();
+	EXPECT_NE(copy, genome);
+	EXPECT_FALSE(cache.find(copy).has_value());
+
+	neat::Genome grown{ genome };
+	grown.addHiddenNode();
+	EXPECT_FALSE(cache.find(grown).has_value());
+
+	EXPECT_EQ(cache.hitCount(), 2);
+	EXPECT_EQ(cache.missCount(), 2);
+}
+
+TEST(FitnessCacheTests, LeastRecentlyUsedGenomeIsForgotten)
+{
+	neat::FitnessCache cache{ 2 };
+
+	neat::Genome genome1 = createGenome();
+	neat::Genome genome2 = neat::Genome{ genome1 }.mutateConnectionGenes();
+	neat::Genome genome3 = neat::Genome{ genome1 }.mutateConnectionGenes();
+
+	cache.insert(genome1, 1.0f);
+	cache.insert(genome2, 2.0f);
+
+	// Using genome1 makes genome2 the least recently used one.
+	EXPECT_TRUE(cache.find(genome1).has_value());
+	cache.insert(genome3, 3.0f);
+
+	EXPECT_EQ(cache.size(), 2);
+	EXPECT_TRUE(cache.find(genome1).has_value());
+	EXPECT_FALSE(cache.find(genome2).has_value());
+	EXPECT_EQ(*cache.find(genome3), 3.0f);
+}
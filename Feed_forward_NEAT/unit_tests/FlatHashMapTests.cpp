@@ -0,0 +1,88 @@
+#include <gtest/gtest.h>
+
+#include <flat_hash_map.h>
+#include <innovation_registry.h>
+
+#include <unordered_map>
+#include <random>
+
+
+TEST(FlatHashMapTests, BehavesLikeUnorderedMap)
+{
+	neat::FlatHashMap<uint64_t, uint64_t> map;
+	std::unordered_map<uint64_t, uint64_t> reference;
+
+	// Small keys collide a lot after masking, which exercises probing and the backward shift on erase.
+	std::mt19937 gen(7);
+	std::uniform_int_distribution<uint64_t> keyRnd(0, 500);
+	for (size_t i = 0; i < 20000; i++)
+	{
+		const uint64_t key = keyRnd(gen);
+		if (gen() % 3 == 0)
+		{
+			EXPECT_EQ(map.erase(key), reference.erase(key));
+		}
+		else
+		{
+			map[key] += i;
+			reference[key] += i;
+		}
+	}
+
+	ASSERT_EQ(map.size(), reference.size());
+	for (const auto& [key, value] : reference)
+		EXPECT_EQ(map.at(key), value);
+
+	size_t iterated = 0;
+	for (const auto& [key, value] : map)
+	{
+		EXPECT_EQ(reference.at(key), value);
+		iterated++;
+	}
+	EXPECT_EQ(iterated, reference.size());
+
+	map.eraseIf([](const auto& entry) { return entry.first % 2 == 0; });
+	for (uint64_t key = 0; key <= 500; key++)
+		EXPECT_EQ(map.contains(key), key % 2 == 1 && reference.count(key) == 1);
+}
+
+namespace
+{
+	// Every key wants one of the last two slots of the 16, so the probe sequences wrap around the end of the slots.
+	struct WrappingHash
+	{
+		inline uint64_t operator()(uint64_t key) const { return 14 + key % 2; }
+	};
+}
+
+TEST(FlatHashMapTests, EraseIfKeepsWrappedEntriesReachable)
+{
+	neat::FlatHashMap<uint64_t, uint64_t, WrappingHash> map;
+	for (uint64_t key = 0; key < 10; key++)
+		map[key] = key;
+	const size_t capacity = map.capacity();
+
+	size_t checked = 0;
+	map.eraseIf([&](const auto& entry) { checked++; return entry.first % 3 == 0; });
+
+	// Every entry is checked once, and the memory is kept.
+	EXPECT_EQ(checked, 10);
+	EXPECT_EQ(map.capacity(), capacity);
+	EXPECT_EQ(map.size(), 6);
+	for (uint64_t key = 0; key < 10; key++)
+	{
+		EXPECT_EQ(map.contains(key), key % 3 != 0);
+		if (key % 3 != 0)
+		{
+			EXPECT_EQ(map.at(key), key);
+		}
+	}
+}
+
+TEST(FlatHashMapTests, PairHashIsNotSymmetric)
+{
+	const hashPair hash;
+	EXPECT_NE(hash({ 3, 7 }), hash({ 7, 3 }));
+	EXPECT_NE(hash({ 3, 3 }), hash({ 7, 7 }));
+	EXPECT_NE(hash({ 0, 0 }), hash({ 1, 1 }));
+}
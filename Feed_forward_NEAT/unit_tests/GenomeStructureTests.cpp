@@ -0,0 +1,534 @@
+#include <gtest/gtest.h>
+
+#include <vector>
+
+#include <NEAT.h>
+
+
+namespace
+{
+	// Checks that every connection goes from a node earlier in the topological order to a node later in it.
+	bool isValidTopologicalOrder(const neat::Genome& genome, const std::vector<std::pair<uint64_t, uint64_t>>& connections)
+	{
+		const auto& order = genome.topologicalOrder();
+		if (order.size() != genome.numberOfNodes() + 1)
+			return false;
+
+		std::vector<size_t> position(order.size());
+		for (size_t i = 0; i < order.size(); i++)
+			position[order[i]] = i;
+
+		for (const auto& [inNode, outNode] : connections)
+		{
+			if (position[inNode] >= position[outNode])
+				return false;
+		}
+
+		return true;
+	}
+
+	// The innovation number of the connection from inNode to outNode. Innovations can be remembered from earlier tests, so a new connection isn't necessarily the last one.
+	uint64_t innovationNumberOf(const neat::Genome& genome, uint64_t inNode, uint64_t outNode)
+	{
+		for (const auto& connection : genome.topology().connections())
+		{
+			if (connection.inNode == inNode && connection.outNode == outNode)
+				return connection.innovationNumber;
+		}
+
+		ADD_FAILURE() << "No connection from " << inNode << " to " << outNode;
+		return 0;
+	}
+}
+
+
+TEST(GenomeStructureTests, LoopingConnectionsAreRejected)
+{
+	neat::Genome genome{ 1, 1 };
+	genome.addHiddenNode().addHiddenNode().addHiddenNode();
+
+	// 3 -> 4 -> 5 -> 2
+	ASSERT_TRUE(genome.addConnectionGene(5, 2, 1.0f));
+	ASSERT_TRUE(genome.addConnectionGene(4, 5, 1.0f));
+	ASSERT_TRUE(genome.addConnectionGene(3, 4, 1.0f));
+
+	// Rejected connections and replaced weights leave the topology as it was.
+	const neat::Genome before{ genome };
+	EXPECT_FALSE(genome.addConnectionGene(5, 3, 1.0f));
+	EXPECT_FALSE(genome.addConnectionGene(4, 3, 1.0f));
+	EXPECT_FALSE(genome.addConnectionGene(4, 4, 1.0f));
+	EXPECT_TRUE(genome.addConnectionGene(4, 5, -1.0f));
+	EXPECT_TRUE(genome.sharesTopologyWith(before));
+
+	EXPECT_TRUE(genome.addConnectionGene(3, 5, 1.0f));
+
+	EXPECT_EQ(genome.numberOfConnections(), 4);
+	EXPECT_TRUE(isValidTopologicalOrder(genome, { {5, 2}, {4, 5}, {3, 4}, {3, 5} }));
+}
+
+TEST(GenomeStructureTests, TopologicalOrderSurvivesReordering)
+{
+	neat::Genome genome{ 2, 1 };
+	genome.addHiddenNode().addHiddenNode();
+
+	// Added in the reverse of the order the nodes were created in, so the order has to be rearranged every time.
+	std::vector<std::pair<uint64_t, uint64_t>> connections{ {5, 3}, {4, 5}, {0, 4}, {1, 5}, {2, 4} };
+	for (const auto& [inNode, outNode] : connections)
+		ASSERT_TRUE(genome.addConnectionGene(inNode, outNode, 1.0f));
+
+	EXPECT_TRUE(isValidTopologicalOrder(genome, connections));
+
+	// The copy must keep the order.
+	neat::Genome copy{ genome };
+	EXPECT_TRUE(isValidTopologicalOrder(copy, connections));
+}
+
+TEST(GenomeStructureTests, ConnectionMutationStopsWhenSaturated)
+{
+	neat::Genome genome{ 2, 2 };
+	genome.addHiddenNode().addHiddenNode();
+
+	// (2 inputs + bias) * (2 outputs + 2 hidden) + 2 hidden * 2 outputs + 1 hidden pair
+	ASSERT_EQ(genome.numberOfPossibleConnections(), 17);
+
+	// Every mutation adds a new connection, until there are no more to add.
+	for (uint64_t i = 1; i <= 17; i++)
+	{
+		genome.addConnectionMutation();
+		EXPECT_EQ(genome.numberOfConnections(), i);
+	}
+
+	genome.addConnectionMutation();
+	EXPECT_EQ(genome.numberOfConnections(), 17);
+}
+
+TEST(GenomeStructureTests, AddableConnectionsMatchEveryValidPair)
+{
+	neat::Genome genome{ 3, 2 };
+	for (size_t i = 0; i < 60; i++)
+	{
+		if (i % 4 == 0 && genome.numberOfConnections() > 0)
+			genome.addNodeMutation();
+		else
+			genome.addConnectionMutation();
+		if (i % 10 == 9)
+			genome.collectGarbage(0);
+
+		// Try every pair on a copy: a pair can be added if it isn't connected yet and the copy accepts it.
+		uint64_t validPairs = 0;
+		const uint64_t nodeCount = genome.topology().nodeGenes().size();
+		for (uint64_t source = 0; source < nodeCount; source++)
+		{
+			for (uint64_t target = 0; target < nodeCount; target++)
+			{
+				const auto sourceType = genome.topology().nodeGenes()[source].type();
+				const auto targetType = genome.topology().nodeGenes()[target].type();
+				if (source == target || sourceType == neat::Genome::NodeGene::NodeType::OUTPUT || targetType == neat::Genome::NodeGene::NodeType::INPUT)
+					continue;
+
+				neat::Genome copy{ genome };
+				const uint64_t connectionCount = copy.numberOfConnections();
+				validPairs += copy.addConnectionGene(source, target, 1.0f) && copy.numberOfConnections() > connectionCount;
+			}
+		}
+
+		ASSERT_EQ(genome.numberOfAddableConnections(), validPairs);
+	}
+}
+
+TEST(GenomeStructureTests, ConnectionMutationConnectsHiddenNodesEitherWay)
+{
+	neat::Genome genome{ 1, 1 };
+	genome.addHiddenNode().addHiddenNode();
+	for (uint64_t source : { 0, 1, 3, 4 })
+	{
+		for (uint64_t target : { 2, 3, 4 })
+		{
+			if (source < 3 || target == 2)
+			{
+				ASSERT_TRUE(genome.addConnectionGene(source, target, 1.0f));
+			}
+		}
+	}
+	ASSERT_EQ(genome.numberOfConnections() + 1, genome.numberOfPossibleConnections());
+
+	// 3 comes before 4 in the topological order, but without a path between them, 4 -> 3 is just as valid as 3 -> 4.
+	bool forward = false, backward = false;
+	for (size_t i = 0; i < 100 && !(forward && backward); i++)
+	{
+		neat::Genome copy{ genome };
+		copy.addConnectionMutation();
+		ASSERT_EQ(copy.numberOfConnections(), genome.numberOfConnections() + 1);
+
+		for (const auto& connection : copy.topology().connections())
+		{
+			forward |= connection.inNode == 3 && connection.outNode == 4;
+			backward |= connection.inNode == 4 && connection.outNode == 3;
+		}
+	}
+
+	EXPECT_TRUE(forward);
+	EXPECT_TRUE(backward);
+}
+
+TEST(GenomeStructureTests, ThresholdedCompatibilityDistanceAgreesBelowCutoff)
+{
+	neat::Genome parent{ 4, 2 };
+	for (size_t i = 0; i < 100; i++)
+	{
+		parent.addConnectionMutation();
+		if (i % 10 == 9)
+			parent.addNodeMutation();
+	}
+
+	for (size_t i = 0; i < 50; i++)
+	{
+		neat::Genome child{ parent };
+		child.mutate(0.8f, 0.2f, 0.5f);
+
+		const float distance = parent.calculateCompatibilityDistance(child, 1.0f, 1.0f, 0.4f);
+		for (float cutoff : { 0.1f, 0.5f, 1.0f, 3.0f })
+		{
+			const float thresholdedDistance = parent.calculateCompatibilityDistance(child, 1.0f, 1.0f, 0.4f, cutoff);
+			if (distance < cutoff)
+				EXPECT_FLOAT_EQ(thresholdedDistance, distance);
+			else
+				EXPECT_GE(thresholdedDistance, cutoff);
+		}
+	}
+}
+
+TEST(GenomeStructureTests, CopiesShareTopologyUntilStructurallyModified)
+{
+	neat::Genome original{ 3, 2 };
+	for (size_t i = 0; i < 10; i++)
+		original.addConnectionMutation();
+	original.addNodeMutation();
+
+	neat::Genome copy{ original };
+	EXPECT_TRUE(copy.sharesTopologyWith(original));
+	EXPECT_EQ(original.calculateCompatibilityDistance(copy, 1.0f, 1.0f, 0.4f), 0.0f);
+
+	// Evaluating a copy or mutating its weights doesn't change its structure.
+	copy.resetCache();
+	copy.setInputValues({ 0.5f, 0.25f, 1.0f });
+	copy.evaluateOutputNodes();
+	copy.mutateConnectionGenes();
+	EXPECT_TRUE(copy.sharesTopologyWith(original));
+
+	const auto connectionCount = original.numberOfConnections();
+	copy.addNodeMutation();
+	EXPECT_FALSE(copy.sharesTopologyWith(original));
+	EXPECT_EQ(original.numberOfConnections(), connectionCount);
+	EXPECT_EQ(copy.numberOfConnections(), connectionCount + 2);
+}
+
+TEST(GenomeStructureTests, IdenticalStructuresShareTopology)
+{
+	neat::Genome genome1{ 2, 1 };
+	neat::Genome genome2{ 2, 1 };
+	EXPECT_TRUE(genome1.sharesTopologyWith(genome2));
+
+	// The same connections get the same innovation numbers within a generation, so the genomes end up with the same structure.
+	ASSERT_TRUE(genome1.addConnectionGene(0, 3, 1.0f));
+	ASSERT_TRUE(genome1.addConnectionGene(2, 3, 0.5f));
+	EXPECT_FALSE(genome1.sharesTopologyWith(genome2));
+
+	ASSERT_TRUE(genome2.addConnectionGene(2, 3, -2.0f));
+	ASSERT_TRUE(genome2.addConnectionGene(0, 3, 3.0f, false));
+	EXPECT_TRUE(genome1.sharesTopologyWith(genome2));
+
+	// The weights and expressed flags are still per genome.
+	const auto& connections = genome1.topology().connections();
+	const size_t index = connections[0].inNode == 0 ? 0 : 1;
+	EXPECT_FLOAT_EQ(genome1.weights()[index], 1.0f);
+	EXPECT_FLOAT_EQ(genome2.weights()[index], 3.0f);
+	EXPECT_TRUE(genome1.isConnectionExpressed(index));
+	EXPECT_FALSE(genome2.isConnectionExpressed(index));
+}
+
+TEST(GenomeStructureTests, InnovationsFollowNodesNotIndices)
+{
+	neat::Genome genome1{ 2, 1 };
+	ASSERT_TRUE(genome1.addConnectionGene(0, 3, 1.0f));
+	ASSERT_TRUE(genome1.addConnectionGene(1, 3, 1.0f));
+	neat::Genome genome2{ genome1 };
+	neat::Genome genome3{ genome1 };
+
+	// Both genomes split a different connection, and both new nodes are node 4 within their genome.
+	while (genome1.numberOfConnections() == 2)
+		genome1.addNodeMutation();
+	do
+	{
+		genome2 = genome3;
+		genome2.addNodeMutation();
+	} while (genome2.isConnectionExpressed(0) == genome1.isConnectionExpressed(0));
+
+	// So the new nodes and their connections must be different innovations.
+	EXPECT_NE(genome1.topology().nodeIds()[4], genome2.topology().nodeIds()[4]);
+	EXPECT_NE(innovationNumberOf(genome1, 4, 3), innovationNumberOf(genome2, 4, 3));
+
+	// Splitting the same connection as genome1 leads to the same node and innovations.
+	do
+	{
+		genome3 = genome2;
+		genome3.addNodeMutation();
+	} while (genome3.isConnectionExpressed(0) || genome3.isConnectionExpressed(1));
+	EXPECT_EQ(genome3.topology().nodeIds()[5], genome1.topology().nodeIds()[4]);
+	EXPECT_EQ(genome3.calculateCompatibilityDistance(genome1, 1.0f, 1.0f, 0.0f), 2.0f / 6.0f);
+
+	// Connecting the same nodes gives the same innovation, even though the node has a different index in each genome.
+	ASSERT_TRUE(genome1.addConnectionGene(2, 4, 1.0f));
+	ASSERT_TRUE(genome3.addConnectionGene(2, 5, 1.0f));
+	EXPECT_EQ(innovationNumberOf(genome1, 2, 4), innovationNumberOf(genome3, 2, 5));
+}
+
+TEST(GenomeStructureTests, GarbageCollectionKeepsOutputsUnchanged)
+{
+	neat::Genome genome{ 3, 2 };
+	for (size_t i = 0; i < 20; i++)
+	{
+		genome.addConnectionMutation();
+		if (i % 4 == 3)
+			genome.addNodeMutation();
+	}
+
+	// A hidden node without a path to an output.
+	genome.addHiddenNode();
+	const uint64_t deadNode = genome.numberOfNodes();
+	ASSERT_TRUE(genome.addConnectionGene(0, deadNode, 1.0f));
+
+	const std::vector<float> inputs{ 0.3f, 0.6f, 0.9f };
+	genome.setInputValues(inputs);
+	genome.evaluateOutputNodes();
+	const auto outputs = genome.getOutputValues();
+
+	const auto hiddenCount = genome.numberOfHiddenNodes();
+	const auto connectionCount = genome.numberOfConnections();
+
+	// The unreachable node goes right away, the disabled connections only once they have been disabled for long enough.
+	genome.collectGarbage(2);
+	EXPECT_EQ(genome.numberOfHiddenNodes(), hiddenCount - 1);
+	genome.collectGarbage(2);
+	genome.collectGarbage(2);
+
+	size_t disabledCount = 0;
+	for (size_t i = 0; i < genome.numberOfConnections(); i++)
+		disabledCount += !genome.isConnectionExpressed(i);
+	EXPECT_EQ(disabledCount, 0);
+	EXPECT_LT(genome.numberOfConnections(), connectionCount);
+
+	genome.setInputValues(inputs);
+	genome.evaluateOutputNodes();
+	const auto collectedOutputs = genome.getOutputValues();
+	for (size_t i = 0; i < outputs.size(); i++)
+		EXPECT_FLOAT_EQ(collectedOutputs[i], outputs[i]);
+
+	// The genome is still valid to mutate.
+	for (size_t i = 0; i < 10; i++)
+		genome.mutate(1.0f, 0.5f, 0.5f);
+}
+
+TEST(GenomeStructureTests, GarbageCollectionKeepsInnovationsOfRenumberedNodes)
+{
+	neat::Genome genome{ 2, 1 };
+	ASSERT_TRUE(genome.addConnectionGene(0, 3, 1.0f));
+
+	// Node 4 has no path to the output, so garbage collection removes it, and node 5 becomes node 4.
+	genome.addHiddenNode();
+	ASSERT_TRUE(genome.addConnectionGene(1, 4, 1.0f));
+
+	// Split 0 -> 3 (the first connection) into 0 -> 5 -> 3.
+	const neat::Genome base{ genome };
+	do
+	{
+		genome = base;
+		genome.addNodeMutation();
+	} while (genome.isConnectionExpressed(0));
+
+	neat::Genome collected{ genome };
+	collected.collectGarbage(100);
+	ASSERT_EQ(collected.numberOfHiddenNodes(), 1);
+	EXPECT_EQ(collected.topology().nodeIds()[4], genome.topology().nodeIds()[5]);
+
+	// The same connection gets the same innovation, whatever the index of its node is.
+	ASSERT_TRUE(genome.addConnectionGene(2, 5, 1.0f));
+	ASSERT_TRUE(collected.addConnectionGene(2, 4, 1.0f));
+	EXPECT_EQ(innovationNumberOf(genome, 2, 5), innovationNumberOf(collected, 2, 4));
+
+	// While a connection into the node that used to be node 4 is a different one.
+	ASSERT_TRUE(genome.addConnectionGene(2, 4, 1.0f));
+	EXPECT_NE(innovationNumberOf(genome, 2, 4), innovationNumberOf(collected, 2, 4));
+}
+
+TEST(GenomeStructureTests, SmallGenomesStayInlineUntilTheyGrow)
+{
+	neat::Genome genome{ 2, 1 };
+	genome.addHiddenNode();
+	ASSERT_TRUE(genome.addConnectionGene(0, 4, 1.0f));
+	ASSERT_TRUE(genome.addConnectionGene(1, 4, -1.0f));
+	ASSERT_TRUE(genome.addConnectionGene(4, 3, 2.0f));
+
+	neat::Genome copy{ genome };
+	EXPECT_TRUE(copy.weights().isInline());
+
+	// Larger genomes move to the heap, and behave the same.
+	neat::Genome large{ 10, 5 };
+	while (large.numberOfConnections() <= neat::Genome::inlineConnectionCount_c)
+		large.addConnectionMutation();
+	large.addNodeMutation();
+	EXPECT_FALSE(large.weights().isInline());
+
+	neat::Genome largeCopy{ large };
+	EXPECT_FALSE(largeCopy.weights().isInline());
+	EXPECT_TRUE(largeCopy == large);
+
+	const std::vector<float> inputs{ 0.1f, 0.2f, 0.3f, 0.4f, 0.5f, 0.6f, 0.7f, 0.8f, 0.9f, 1.0f };
+	large.setInputValues(inputs);
+	large.evaluateOutputNodes();
+	largeCopy.setInputValues(inputs);
+	largeCopy.evaluateOutputNodes();
+	EXPECT_EQ(large.getOutputValues(), largeCopy.getOutputValues());
+}
+
+TEST(GenomeStructureTests, LargeCopiesShareValuesUntilModified)
+{
+	neat::Genome large{ 10, 5 };
+	while (large.numberOfConnections() <= neat::Genome::inlineConnectionCount_c)
+		large.addConnectionMutation();
+	large.addNodeMutation();
+	large.collectGarbage(100);
+
+	// Copies share the weights (and expressed flags) instead of copying them.
+	neat::Genome copy{ large };
+	EXPECT_EQ(&copy.weights(), &large.weights());
+
+	// Garbage collection only changes them when connections are disabled or enabled.
+	large.collectGarbage(100);
+	copy.collectGarbage(100);
+	EXPECT_EQ(&copy.weights(), &large.weights());
+
+	// A copy that is modified gets its own values, and leaves the original alone.
+	const std::vector<float> weights(large.weights().begin(), large.weights().end());
+	copy.mutateConnectionGenes();
+	EXPECT_NE(&copy.weights(), &large.weights());
+	EXPECT_EQ(std::vector<float>(large.weights().begin(), large.weights().end()), weights);
+	EXPECT_FALSE(copy == large);
+}
+
+TEST(GenomeStructureTests, CrossoverMixesMatchingGenesAndDisablesSome)
+{
+	// Two parents with the same 64+ connections, but different weights, and every connection disabled in parent2.
+	neat::Genome parent1{ 10, 8 };
+	while (parent1.numberOfConnections() < 80)
+		parent1.addConnectionMutation();
+	neat::Genome parent2{ parent1 };
+
+	// Adding an existing connection again replaces its weight and expressed flag.
+	const auto connections = parent1.topology().connections();
+	for (const auto& connection : connections)
+	{
+		parent1.addConnectionGene(connection.inNode, connection.outNode, 1.0f);
+		parent2.addConnectionGene(connection.inNode, connection.outNode, 2.0f, false);
+	}
+	ASSERT_TRUE(parent1.sharesTopologyWith(parent2));
+
+	std::vector<std::pair<const neat::Genome*, const neat::Genome*>> parents(50, { &parent1, &parent2 });
+	std::vector<neat::Genome> children;
+	neat::ThreadPool threadPool{ 2 };
+	neat::Genome::crossover(parents, children, 0, &threadPool);
+	children.emplace_back(parent1, parent2);
+	ASSERT_EQ(children.size(), parents.size() + 1);
+
+	// Breeding into existing children overwrites them instead of adding more.
+	neat::Genome::crossover(parents, children, 1, &threadPool);
+	ASSERT_EQ(children.size(), parents.size() + 1);
+
+	size_t fromParent2 = 0, disabled = 0, total = 0;
+	for (const auto& child : children)
+	{
+		EXPECT_TRUE(child.sharesTopologyWith(parent1));
+		for (size_t i = 0; i < child.numberOfConnections(); i++)
+		{
+			fromParent2 += child.weights()[i] == 2.0f;
+			disabled += !child.isConnectionExpressed(i);
+			total++;
+		}
+	}
+
+	// Half the genes come from each parent. Genes from parent2 are always disabled, the others 75% of the time.
+	EXPECT_NEAR(static_cast<float>(fromParent2) / total, 0.5f, 0.05f);
+	EXPECT_NEAR(static_cast<float>(disabled) / total, 0.5f + 0.5f * 0.75f, 0.05f);
+}
+
+TEST(GenomeStructureTests, CompatibilityLowerBoundNeverExceedsDistance)
+{
+	// Related genomes with different structural mutations, so they have matching, disjoint and excess genes.
+	neat::Genome base{ 4, 2 };
+	for (size_t i = 0; i < 6; i++)
+		base.addConnectionMutation();
+
+	std::vector<neat::Genome> genomes(12, base);
+	for (size_t i = 0; i < genomes.size(); i++)
+	{
+		for (size_t j = 0; j < i; j++)
+			genomes[i].mutate(1.0f, 0.3f, 0.7f);
+	}
+
+	size_t prunableCount = 0;
+	for (const auto& a : genomes)
+	{
+		for (const auto& b : genomes)
+		{
+			const float distance = a.calculateCompatibilityDistance(b, 1.0f, 1.0f, 0.4f);
+			const float lowerBound = a.compatibilityDistanceLowerBound(b, 1.0f, 1.0f);
+			EXPECT_LE(lowerBound, distance + 1e-5f);
+			prunableCount += lowerBound >= 0.5f;
+
+			// With a cutoff, the distance is either exact, or at least the cutoff.
+			const float cutoffDistance = a.calculateCompatibilityDistance(b, 1.0f, 1.0f, 0.4f, 0.5f);
+			if (distance < 0.5f)
+				EXPECT_FLOAT_EQ(cutoffDistance, distance);
+			else
+				EXPECT_GE(cutoffDistance, 0.5f);
+		}
+	}
+
+	// The bound has to actually rule out some pairs to be of any use.
+	EXPECT_GT(prunableCount, 0);
+}
+
+TEST(GenomeStructureTests, CompatibilityLowerBoundPrunesLargeGenomes)
+{
+	// Two genomes that share 1500 connections, and have 300 connections each that the other doesn't. Far more genes than a fixed size signature could tell apart.
+	const size_t inputCount = 50, outputCount = 50;
+	auto connect = [&](neat::Genome& genome, size_t begin, size_t end)
+	{
+		for (size_t c = begin; c < end; c++)
+			genome.addConnectionGene(c % (inputCount + 1), inputCount + 1 + c / (inputCount + 1), 1.0f);
+	};
+
+	neat::Genome small{ inputCount, outputCount };
+	connect(small, 0, 100);
+	neat::Genome a = small, b = small;
+	connect(a, 100, 1500);
+	connect(b, 100, 1500);
+	connect(a, 1500, 1800);
+	connect(b, 1800, 2100);
+	ASSERT_EQ(a.numberOfConnections(), 1800);
+	ASSERT_EQ(b.numberOfConnections(), 1800);
+
+	// 600 of the 1800 genes aren't matching, and matching genes have the same weight.
+	const float distance = a.calculateCompatibilityDistance(b, 1.0f, 1.0f, 0.4f);
+	EXPECT_NEAR(distance, 600.0f / 1800.0f, 1e-5f);
+
+	// The signatures still tell most of the non-matching genes apart, so the bound rules the pair out for a cutoff well below the distance.
+	const float lowerBound = a.compatibilityDistanceLowerBound(b, 1.0f, 1.0f);
+	EXPECT_LE(lowerBound, distance + 1e-5f);
+	EXPECT_GE(lowerBound, 0.15f);
+
+	// Signatures of different sizes can still be compared.
+	EXPECT_LT(small.topology().signature().size(), a.topology().signature().size());
+	EXPECT_LE(small.compatibilityDistanceLowerBound(a, 1.0f, 1.0f), small.calculateCompatibilityDistance(a, 1.0f, 1.0f, 0.4f) + 1e-5f);
+	EXPECT_FLOAT_EQ(small.compatibilityDistanceLowerBound(a, 1.0f, 1.0f), a.compatibilityDistanceLowerBound(small, 1.0f, 1.0f));
+}
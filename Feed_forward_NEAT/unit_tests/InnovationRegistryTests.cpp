@@ -0,0 +1,103 @@
+#include <gtest/gtest.h>
+
+#include <thread>
+#include <vector>
+
+#include <innovation_registry.h>
+#include <NEAT.h>
+
+
+TEST(InnovationRegistryTests, IdenticalConnectionsShareInnovationNumbers)
+{
+	neat::InnovationRegistry registry;
+
+	const uint64_t first = registry.getInnovationNumber(0, 3);
+	const uint64_t second = registry.getInnovationNumber(3, 0);
+
+	EXPECT_NE(first, second);
+	EXPECT_EQ(registry.getInnovationNumber(0, 3), first);
+	EXPECT_EQ(registry.getInnovationNumber(3, 0), second);
+	EXPECT_EQ(registry.innovationCount(), 2);
+}
+
+TEST(InnovationRegistryTests, SplitsOfTheSameConnectionShareNodeIds)
+{
+	neat::InnovationRegistry registry;
+
+	const uint64_t first = registry.getSplitNodeId(7);
+	const uint64_t second = registry.getSplitNodeId(8);
+
+	EXPECT_GE(first, neat::InnovationRegistry::firstNodeId_c);
+	EXPECT_NE(first, second);
+	EXPECT_EQ(registry.getSplitNodeId(7), first);
+
+	// Node ids that don't come from a split are always new.
+	const uint64_t unrelated = registry.newNodeId();
+	EXPECT_NE(unrelated, first);
+	EXPECT_NE(unrelated, second);
+
+	// Splits are forgotten like any other innovation.
+	registry.nextGeneration();
+	EXPECT_NE(registry.getSplitNodeId(7), first);
+}
+
+TEST(InnovationRegistryTests, InnovationsAreForgottenAfterTheirGeneration)
+{
+	neat::InnovationRegistry registry{ 2 };
+
+	const uint64_t first = registry.getInnovationNumber(0, 3);
+	registry.nextGeneration();
+
+	// Still remembered one generation later (and refreshed by being seen).
+	EXPECT_EQ(registry.getInnovationNumber(0, 3), first);
+	registry.nextGeneration();
+	EXPECT_EQ(registry.getInnovationNumber(0, 3), first);
+
+	registry.nextGeneration();
+	registry.nextGeneration();
+	EXPECT_EQ(registry.rememberedInnovationCount(), 0);
+	EXPECT_NE(registry.getInnovationNumber(0, 3), first);
+}
+
+TEST(InnovationRegistryTests, ConcurrentMutationsAgreeOnInnovationNumbers)
+{
+	neat::InnovationRegistry registry;
+
+	const size_t threadCount = 8;
+	const uint64_t nodeCount = 64;
+	std::vector<std::vector<uint64_t>> results(threadCount);
+
+	std::vector<std::thread> threads;
+	for (size_t t = 0; t < threadCount; t++)
+	{
+		threads.emplace_back([&, t]()
+			{
+				for (uint64_t i = 0; i < nodeCount; i++)
+					for (uint64_t j = 0; j < nodeCount; j++)
+						results[t].push_back(registry.getInnovationNumber(i, j));
+			});
+	}
+	for (auto& thread : threads)
+		thread.join();
+
+	for (size_t t = 1; t < threadCount; t++)
+		EXPECT_EQ(results[t], results[0]);
+	EXPECT_EQ(registry.innovationCount(), nodeCount * nodeCount);
+}
+
+TEST(InnovationRegistryTests, InnovationNumbersStopAtWhatConnectionGenesHold)
+{
+	neat::InnovationRegistry registry;
+	registry.reserveInnovationNumbers(neat::InnovationRegistry::maxInnovationCount_c - 1);
+
+	// The last number that fits is still handed out, and a connection gene keeps it apart from its expressed flag.
+	const uint64_t last = registry.getInnovationNumber(0, 3);
+	EXPECT_EQ(last, neat::InnovationRegistry::maxInnovationCount_c - 1);
+	EXPECT_EQ(neat::Genome::ConnectionGene(0, 3, 1.0f, true, last).innovationNumber(), last);
+	EXPECT_FALSE(neat::Genome::ConnectionGene(0, 3, 1.0f, false, last).isExpressed());
+
+	// After that, new connections get no number, while known ones keep theirs.
+	EXPECT_EQ(registry.getInnovationNumber(3, 0), neat::InnovationRegistry::noInnovation_c);
+	EXPECT_EQ(registry.getInnovationNumber(0, 3), last);
+	EXPECT_EQ(registry.innovationCount(), neat::InnovationRegistry::maxInnovationCount_c);
+}
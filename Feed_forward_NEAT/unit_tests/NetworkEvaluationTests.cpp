@@ -3,6 +3,7 @@
 #include <vector>
 
 #include <NEAT.h>
+#include <calculator.h>
 
 
 TEST(NetworkEvaluationTests, XorEvaluationTest) {
@@ -41,3 +42,32 @@ TEST(NetworkEvaluationTests, XorEvaluationTest) {
 	}
 }
 
+
+TEST(NetworkEvaluationTests, EvaluationFollowsMutationsWithoutResettingCache)
+{
+	neat::Genome genome{ 4, 2 };
+	for (size_t i = 0; i < 60; i++)
+	{
+		genome.addConnectionMutation();
+		if (i % 6 == 5)
+			genome.addNodeMutation();
+	}
+
+	const std::vector<float> inputs{ 0.1f, 0.7f, 0.4f, 0.9f };
+	for (size_t i = 0; i < 10; i++)
+	{
+		// The previous evaluation must not leak into this one, even though the cache is never reset.
+		genome.setInputValues(inputs);
+		genome.evaluateOutputNodes();
+		const auto outputs = genome.getOutputValues();
+
+		// Calculator::calculate also returns the hidden node values after the outputs.
+		neat::Calculator calculator{ genome };
+		const auto expectedOutputs = calculator.calculate(inputs);
+		ASSERT_EQ(outputs.size(), 2);
+		for (size_t j = 0; j < outputs.size(); j++)
+			EXPECT_FLOAT_EQ(outputs[j], expectedOutputs[j]);
+
+		genome.mutate(1.0f, 0.5f, 0.5f);
+	}
+}
@@ -0,0 +1,119 @@
+#include <gtest/gtest.h>
+
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <NEAT.h>
+#include <calculator.h>
+#include <population_file.h>
+
+
+namespace
+{
+	neat::Genome createRandomGenome()
+	{
+		neat::Genome genome{ 5, 3 };
+		for (size_t i = 0; i < 60; i++)
+		{
+			genome.addConnectionMutation();
+			if (i % 6 == 5)
+				genome.addNodeMutation();
+		}
+		genome.mutateConnectionGenes();
+
+		return genome;
+	}
+
+	std::vector<float> evaluate(neat::Genome& genome, const std::vector<float>& inputs)
+	{
+		genome.resetCache();
+		genome.setInputValues(inputs);
+		genome.evaluateOutputNodes();
+		return genome.getOutputValues();
+	}
+}
+
+
+TEST(PopulationFileTests, PopulationRoundTrip)
+{
+	std::vector<neat::Genome> population;
+	for (size_t i = 0; i < 10; i++)
+		population.push_back(createRandomGenome());
+
+	const std::string fileName = testing::TempDir() + "population_round_trip.neat";
+	ASSERT_TRUE(neat::PopulationFile::write(fileName, population));
+
+	neat::PopulationFile file{ fileName };
+	ASSERT_TRUE(file.isValid());
+	EXPECT_EQ(file.kind(), neat::PopulationFile::Kind::POPULATION);
+	ASSERT_EQ(file.genomeCount(), population.size());
+
+	std::vector<neat::Genome> loaded;
+	ASSERT_TRUE(file.loadPopulation(loaded));
+	ASSERT_EQ(loaded.size(), population.size());
+
+	const std::vector<float> inputs{ 0.1f, 0.9f, 0.4f, 0.0f, 1.0f };
+	for (size_t i = 0; i < population.size(); i++)
+	{
+		EXPECT_EQ(loaded[i].numberOfNodes(), population[i].numberOfNodes());
+		EXPECT_EQ(loaded[i].numberOfConnections(), population[i].numberOfConnections());
+		EXPECT_EQ(loaded[i].topologicalOrder(), population[i].topologicalOrder());
+		EXPECT_FLOAT_EQ(loaded[i].calculateCompatibilityDistance(population[i], 1.0f, 1.0f, 0.4f), 0.0f);
+		EXPECT_EQ(evaluate(loaded[i], inputs), evaluate(population[i], inputs));
+		EXPECT_EQ(neat::Calculator{ loaded[i] }.calculate(inputs), neat::Calculator{ population[i] }.calculate(inputs));
+	}
+
+	// Innovation numbers used by the loaded genomes must not be handed out again.
+	EXPECT_GE(neat::Genome::innovationRegistry().innovationCount(), file.innovationCount());
+	EXPECT_GE(neat::Genome::innovationRegistry().nextNodeId(), file.nextNodeId());
+	for (size_t i = 0; i < population.size(); i++)
+		EXPECT_EQ(loaded[i].topology().nodeIds(), population[i].topology().nodeIds());
+}
+
+TEST(PopulationFileTests, CorruptedFilesAreRejected)
+{
+	const std::string fileName = testing::TempDir() + "population_corrupted.neat";
+	ASSERT_TRUE(neat::PopulationFile::write(fileName, createRandomGenome()));
+
+	{
+		neat::PopulationFile file{ fileName };
+		ASSERT_TRUE(file.isValid());
+		EXPECT_EQ(file.kind(), neat::PopulationFile::Kind::GENOME);
+		EXPECT_TRUE(file.loadGenome(0).has_value());
+	}
+
+	// Overwrite the first connection's input node, so it points at a node that doesn't exist.
+	{
+		std::fstream stream{ fileName, std::ios::in | std::ios::out | std::ios::binary };
+		const uint32_t invalidNode = 1000000;
+		stream.seekp(40 + 40);
+		stream.write(reinterpret_cast<const char*>(&invalidNode), sizeof(invalidNode));
+	}
+	{
+		neat::PopulationFile file{ fileName };
+		ASSERT_TRUE(file.isValid());
+		EXPECT_FALSE(file.loadGenome(0).has_value());
+	}
+
+	// An input count so large that adding the other node counts to it would overflow.
+	ASSERT_TRUE(neat::PopulationFile::write(fileName, createRandomGenome()));
+	{
+		std::fstream stream{ fileName, std::ios::in | std::ios::out | std::ios::binary };
+		const uint64_t hugeInputCount = UINT64_MAX - 2;
+		stream.seekp(40);
+		stream.write(reinterpret_cast<const char*>(&hugeInputCount), sizeof(hugeInputCount));
+	}
+	{
+		neat::PopulationFile file{ fileName };
+		ASSERT_TRUE(file.isValid());
+		EXPECT_FALSE(file.loadGenome(0).has_value());
+	}
+
+	// A truncated file is rejected as a whole.
+	{
+		std::ofstream stream{ fileName, std::ios::binary };
+		stream.write("NEAT", 4);
+	}
+	EXPECT_FALSE(neat::PopulationFile{ fileName }.isValid());
+}
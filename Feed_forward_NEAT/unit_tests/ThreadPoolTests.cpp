@@ -0,0 +1,51 @@
+#include <gtest/gtest.h>
+
+#include <thread_pool.h>
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+
+TEST(ThreadPoolTests, ParallelForVisitsEveryIndexOnce)
+{
+	neat::ThreadPool pool{ 4 };
+	EXPECT_EQ(pool.threadCount(), 4);
+
+	// Many short loops in a row, so workers that wake up late get exercised too.
+	for (size_t count : { 0, 1, 2, 7, 100, 1000 })
+	{
+		for (size_t repeat = 0; repeat < 20; repeat++)
+		{
+			std::vector<std::atomic<int>> visits(count);
+			pool.parallelFor(count, [&](size_t i) { visits[i]++; });
+
+			for (size_t i = 0; i < count; i++)
+				ASSERT_EQ(visits[i], 1) << "count " << count << ", index " << i;
+		}
+	}
+}
+
+TEST(ThreadPoolTests, UnevenWorkIsStolen)
+{
+	neat::ThreadPool pool{ 4 };
+
+	// All the expensive items are in the first thread's share, so the other threads have to steal from it.
+	std::vector<std::atomic<int>> visits(400);
+	pool.parallelForRanges(visits.size(), [&](size_t begin, size_t end)
+		{
+			for (size_t i = begin; i < end; i++)
+			{
+				if (i < 100)
+					std::this_thread::sleep_for(std::chrono::microseconds(200));
+				visits[i]++;
+			}
+		}, 4);
+
+	for (size_t i = 0; i < visits.size(); i++)
+		ASSERT_EQ(visits[i], 1) << "index " << i;
+
+	const uint64_t sum = pool.parallelReduce(size_t{ 10000 }, uint64_t{ 0 }, [](size_t i) { return static_cast<uint64_t>(i); }, [](uint64_t a, uint64_t b) { return a + b; }, 16);
+	EXPECT_EQ(sum, 10000ull * 9999ull / 2);
+}
@@ -0,0 +1,104 @@
+#include <gtest/gtest.h>
+
+#include <vector>
+
+#include <NEAT.h>
+#include <random_stream.h>
+
+
+TEST(WeightMutationTests, RandomStreamFloatsAreUniform)
+{
+	neat::RandomStream random{ 12345 };
+
+	constexpr size_t sampleCount = 100000;
+	double sum = 0;
+	size_t lowerQuarter = 0;
+	float values[4];
+	for (size_t i = 0; i < sampleCount / 4; i++)
+	{
+		random.nextFloats(values);
+		for (float value : values)
+		{
+			ASSERT_GE(value, 0.0f);
+			ASSERT_LT(value, 1.0f);
+			sum += value;
+			lowerQuarter += value < 0.25f;
+		}
+	}
+
+	EXPECT_NEAR(sum / sampleCount, 0.5, 0.01);
+	EXPECT_NEAR(static_cast<double>(lowerQuarter) / sampleCount, 0.25, 0.01);
+}
+
+TEST(WeightMutationTests, RandomStreamBitsComeFromTheSameGeneratorsAsItsFloats)
+{
+	// Streams with the same seed draw the same outputs, whether they are turned into floats (with SIMD where available) or bits.
+	neat::RandomStream floatStream{ 12345 }, bitStream{ 12345 };
+
+	constexpr size_t drawCount = 25000;
+	size_t setCounts[128]{};
+	float values[4];
+	uint64_t bits[2];
+	for (size_t i = 0; i < drawCount; i++)
+	{
+		floatStream.nextFloats(values);
+		bitStream.nextBits(bits);
+		for (int lane = 0; lane < 4; lane++)
+		{
+			const uint32_t output = static_cast<uint32_t>(bits[lane / 2] >> (32 * (lane % 2)));
+			ASSERT_EQ(values[lane], (output >> 8) / 16777216.0f);
+		}
+
+		for (int b = 0; b < 128; b++)
+			setCounts[b] += (bits[b / 64] >> (b % 64)) & 1;
+	}
+
+	// Every bit, including the lowest of every output, is as likely to be set as not.
+	for (int b = 0; b < 128; b++)
+		EXPECT_NEAR(static_cast<double>(setCounts[b]) / drawCount, 0.5, 0.02) << "bit " << b;
+}
+
+TEST(WeightMutationTests, BatchMutationResetsOrPerturbsEveryWeight)
+{
+	// Every weight starts far outside the reset range, so reset and perturbed weights can be told apart.
+	constexpr float initialWeight = 100.0f;
+	std::vector<neat::Genome> genomes(200, neat::Genome{ 10, 10 });
+	for (auto& genome : genomes)
+	{
+		for (uint64_t inNode = 0; inNode < 10; inNode++)
+		{
+			for (uint64_t outNode = 11; outNode < 21; outNode++)
+				ASSERT_TRUE(genome.addConnectionGene(inNode, outNode, initialWeight));
+		}
+	}
+
+	std::vector<neat::Genome*> genomePointers;
+	for (auto& genome : genomes)
+		genomePointers.push_back(&genome);
+
+	neat::ThreadPool threadPool{ 4 };
+	neat::Genome::mutateConnectionGenes(genomePointers, &threadPool);
+
+	size_t weightCount = 0, resetCount = 0;
+	for (size_t i = 0; i < genomes.size(); i++)
+	{
+		// Only the weights change.
+		EXPECT_TRUE(genomes[i].sharesTopologyWith(genomes[0]));
+
+		for (float weight : genomes[i].weights())
+		{
+			weightCount++;
+			// A perturbation just below 5 can round up to exactly initialWeight + 5.
+			if (weight >= -12.0f && weight < 12.0f)
+				resetCount++;
+			else
+				EXPECT_TRUE(weight >= initialWeight - 5.0f && weight <= initialWeight + 5.0f);
+		}
+	}
+
+	EXPECT_EQ(weightCount, 200 * 100);
+	EXPECT_NEAR(static_cast<double>(resetCount) / weightCount, 0.1, 0.01);
+
+	// Different genomes (which may be mutated on different threads) don't get the same mutations.
+	EXPECT_NE(genomes[0].weights(), genomes[199].weights());
+}
@@ -67,10 +67,13 @@ std::array<EvaluatorXor::outputInfo, 5> EvaluatorXor::getTop5Info()
 {
 	std::array<outputInfo, 5> top5{};
 
-	calculateFitnessMap();
+	calculateFitnesses();
 	
-	for (const auto& [genome, fitness] : fitnessMap_)
+	for (size_t i = 0; i < genomes_.size(); i++)
 	{
+		Genome* genome = &genomes_[i];
+		const float fitness = genomeFitness(i);
+
 		if (fitness > top5[0].fitness)
 		{
 			top5[4] = top5[3];
@@ -108,8 +111,6 @@ std::array<EvaluatorXor::outputInfo, 5> EvaluatorXor::getTop5Info()
 
 float EvaluatorXor::evaluateGenomeTraining(Genome& genome)
 {
-	Benchmarker bench{ "Training Evalutor" };
-
 	float fitness = 0;
 	
 	for (size_t i = 0; i < param1training.size(); i++)
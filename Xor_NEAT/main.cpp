@@ -12,7 +12,11 @@ int main()
 	
 	for (size_t i = 0; i < 100; i++)
 	{
-		evaluator.evaluate_training();
+		// Timed per generation rather than per genome, so the stats aren't touched from inside the evaluation.
+		{
+			Benchmarker bench{ "Training generation" };
+			evaluator.evaluate_training();
+		}
 		
 		std::cout << "Generation: " << i << '\n';
 		auto top5 = evaluator.getTop5Info();